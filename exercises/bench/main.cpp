@@ -0,0 +1,684 @@
+﻿#include "../pch.h"
+#include "../tensor/broadcast.h"
+#include "../tensor/expr.h"
+#include "../tensor/iterator.h"
+#include "../tensor/matmul.h"
+#include "../tensor/reduce.h"
+#include "../tensor/static_tensor.h"
+#include "../tensor/storage.h"
+#include "../tensor/view.h"
+
+// 基准测试：像合并编译一样把练习放进各自的命名空间，直接调用其中实现的函数，并与张量库（tensor/）对比。
+// xmake run bench [--history <file>] [filter...]，只运行名称包含任一 filter 的用例，
+// 给出 --history 时把样本追加到该历史文件。
+
+namespace exercise05 {
+#include "../05_constexpr/main.cpp"
+}
+
+namespace exercise06 {
+#include "../06_array/main.cpp"
+}
+
+namespace exercise07 {
+#include "../07_loop/main.cpp"
+}
+
+namespace exercise10 {
+#include "../10_trivial/main.cpp"
+}
+
+namespace exercise11 {
+#include "../11_method/main.cpp"
+}
+
+namespace exercise22 {
+#include "../22_class_template/main.cpp"
+}
+
+namespace exercise23 {
+#include "../23_template_const/main.cpp"
+}
+
+namespace exercise27 {
+#include "../27_strides/main.cpp"
+}
+
+namespace exercise29 {
+#include "../29_std_map/main.cpp"
+}
+
+// 张量库的存储接入与练习 22、23 相同的张量接口（数组成员 `shape` 和指针成员 `data`）：
+// 数据来自 tensor/storage.h 的 64 字节对齐缓冲池，或者接管、借用外部缓冲区；可以移动。
+// 练习本身保持自包含，只在基准测试中与它们对比
+template<unsigned int N, class T>
+struct PooledTensor {
+    unsigned int shape[N];
+    T *data;
+    tensor::Storage<T> storage;
+
+    // 元素清零
+    explicit PooledTensor(unsigned int const shape_[N]) : PooledTensor(shape_, tensor::Storage<T>::allocate(count(shape_))) {
+        std::memset(data, 0, storage.size() * sizeof(T));
+    }
+    PooledTensor(unsigned int const shape_[N], T const *data_) : PooledTensor(shape_, tensor::Storage<T>::allocate(count(shape_))) {
+        std::memcpy(data, data_, storage.size() * sizeof(T));
+    }
+    // 以 `storage_` 为数据，不复制也不清零；其元素数必须与形状一致
+    PooledTensor(unsigned int const shape_[N], tensor::Storage<T> storage_) : storage(std::move(storage_)) {
+        std::memcpy(shape, shape_, sizeof(shape));
+        ASSERT(storage.size() == count(shape_), "Storage of " << storage.size() << " elements for a tensor of " << count(shape_));
+        data = storage.get();
+    }
+
+    PooledTensor(PooledTensor const &) = delete;
+    PooledTensor &operator=(PooledTensor const &) = delete;
+    PooledTensor(PooledTensor &&others) noexcept
+        : data(std::exchange(others.data, nullptr)), storage(std::move(others.storage)) {
+        std::memcpy(shape, others.shape, sizeof(shape));
+    }
+    PooledTensor &operator=(PooledTensor &&others) noexcept {
+        if (this != &others) {
+            std::memcpy(shape, others.shape, sizeof(shape));
+            data = std::exchange(others.data, nullptr);
+            storage = std::move(others.storage);
+        }
+        return *this;
+    }
+
+private:
+    static std::size_t count(unsigned int const shape_[N]) {
+        std::size_t ans = 1;
+        for (auto i = 0u; i < N; ++i) {
+            ans *= shape_[i];
+        }
+        return ans;
+    }
+};
+
+static bool selected(char const *name, std::vector<char const *> const &filters) {
+    if (filters.empty()) {
+        return true;
+    }
+    for (auto filter : filters) {
+        if (std::strstr(name, filter)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char **argv) {
+    std::string history;
+    std::vector<char const *> filters;
+    for (auto i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--history") == 0 && i + 1 < argc) {
+            history = argv[++i];
+        } else {
+            filters.push_back(argv[i]);
+        }
+    }
+
+    std::vector<bench::Result> results;
+    auto add = [&](std::string const &name, auto &&f, bench::Options const &options = {}) {
+        if (selected(name.c_str(), filters)) {
+            results.push_back(bench::measure(name, f, options));
+        }
+    };
+    // 单次迭代读写 `bytes` 字节的用例，表中给出吞吐量
+    auto traffic = [](std::size_t bytes) {
+        bench::Options options;
+        options.bytes = bytes;
+        return options;
+    };
+    // 单次迭代做 `flops` 次浮点运算的用例，表中给出算力；朴素实现很慢，可以减少样本数
+    auto compute = [](std::size_t flops, unsigned int samples = 100) {
+        bench::Options options;
+        options.flops = flops;
+        options.samples = samples;
+        return options;
+    };
+
+    // 斐波那契：朴素递归与各种缓存方式
+    {
+        auto n = 20;
+        add("fibonacci/05 recursive(20)", [&] {
+            bench::do_not_optimize(n);
+            bench::do_not_optimize(exercise05::fibonacci(n));
+        });
+    }
+    {
+        auto n = 80;
+        add("fibonacci/06 memoized(80)", [&] {
+            bench::do_not_optimize(n);
+            bench::do_not_optimize(exercise06::fibonacci(n));
+        });
+    }
+    {
+        auto n = 90;
+        add("fibonacci/07 table(90)", [&] {
+            bench::do_not_optimize(n);
+            bench::do_not_optimize(exercise07::fibonacci(n));
+        });
+    }
+    {
+        auto n = 15;
+        add("fibonacci/10 fresh cache(15)", [&] {
+            exercise10::FibonacciCache cache{};
+            bench::do_not_optimize(n);
+            bench::do_not_optimize(exercise10::fibonacci(cache, n));
+        });
+    }
+    {
+        auto n = 90;
+        add("fibonacci/11 fresh cache(90)", [&] {
+            exercise11::Fibonacci fib{};
+            bench::do_not_optimize(n);
+            bench::do_not_optimize(fib.get(n));
+        });
+    }
+
+    // 张量：广播加法、逐元素下标访问、步长计算
+    {
+        unsigned int s0[]{8, 16, 32, 64}, s1[]{8, 1, 32, 1};
+        std::vector<float> d0(8 * 16 * 32 * 64, 1.f), d1(8 * 32, 2.f);
+        exercise22::Tensor4D<float> t0(s0, d0.data()), t1(s1, d1.data());
+        add("tensor/22 broadcast add 8x16x32x64", [&] {
+            t0 += t1;
+            bench::clobber_memory();
+        }, traffic(2 * d0.size() * sizeof(float)));
+        add("tensor/broadcast_inplace add 8x16x32x64", [&] {
+            tensor::broadcast_inplace(t0.data, 4, t0.shape, t1.data, 4, t1.shape, tensor::Add{});
+            bench::clobber_memory();
+        }, traffic(2 * d0.size() * sizeof(float)));
+    }
+
+    // 存储：反复创建销毁同一大小的张量，缓冲池复用与每次 new[] 对比；借用外部缓冲区则没有分配和复制
+    {
+        unsigned int shape[]{1, 3, 224, 224};
+        constexpr std::size_t N = 3 * 224 * 224;
+        std::vector<float> init(N, 1.f);
+        add("storage/new[] + memcpy 1x3x224x224", [&] {
+            auto data = new float[N];
+            std::memcpy(data, init.data(), N * sizeof(float));
+            bench::do_not_optimize(data);
+            delete[] data;
+        });
+        add("storage/22 Tensor4D new[] 1x3x224x224", [&] {
+            exercise22::Tensor4D<float> t(shape, init.data());
+            bench::do_not_optimize(t.data);
+        });
+        add("storage/pooled tensor 1x3x224x224", [&] {
+            PooledTensor<4, float> t(shape, init.data());
+            bench::do_not_optimize(t.data);
+        });
+        add("storage/borrowed tensor 1x3x224x224", [&] {
+            PooledTensor<4, float> t(shape, tensor::Storage<float>::borrow(init.data(), N));
+            bench::do_not_optimize(t.data);
+        });
+        // 超过 malloc 的 mmap 阈值的大小，每次 new[] 都要向系统申请和归还页面
+        add("storage/new[] 256 KiB", [&] {
+            auto data = new float[1 << 16];
+            bench::do_not_optimize(data);
+            delete[] data;
+        });
+        add("storage/pooled 256 KiB", [&] {
+            auto storage = tensor::Storage<float>::allocate(1 << 16);
+            bench::do_not_optimize(storage.get());
+        });
+        unsigned int large[]{16, 3, 224, 224};
+        add("storage/23 Tensor<4> new[] 16x3x224x224", [&] {
+            exercise23::Tensor<4, float> t(large);
+            bench::do_not_optimize(t.data);
+        });
+        add("storage/pooled tensor 16x3x224x224", [&] {
+            PooledTensor<4, float> t(large);
+            bench::do_not_optimize(t.data);
+        });
+    }
+
+    // 广播引擎：吞吐量（读 dst、src，写 dst）与同样大小的 memcpy 对比
+    {
+        constexpr std::size_t N = 1 << 20;
+        std::vector<float> dst(N, 1.f), src(N, 2.f), copy(N);
+        add("broadcast/memcpy 4 MiB", [&] {
+            std::memcpy(copy.data(), src.data(), N * sizeof(float));
+            bench::clobber_memory();
+        }, traffic(2 * N * sizeof(float)));
+
+        std::size_t shape[]{16, 256, 256};
+        std::size_t same[]{16, 256, 256}, row[]{256}, column[]{16, 256, 1}, scalar[]{1};
+        add("broadcast/same shape 16x256x256", [&] {
+            tensor::broadcast_inplace(dst.data(), 3, shape, src.data(), 3, same, tensor::Add{});
+            bench::clobber_memory();
+        }, traffic(3 * N * sizeof(float)));
+        add("broadcast/row 256 -> 16x256x256", [&] {
+            tensor::broadcast_inplace(dst.data(), 3, shape, src.data(), 1, row, tensor::Add{});
+            bench::clobber_memory();
+        }, traffic(2 * N * sizeof(float)));
+        add("broadcast/column 16x256x1 -> 16x256x256", [&] {
+            tensor::broadcast_inplace(dst.data(), 3, shape, src.data(), 3, column, tensor::Add{});
+            bench::clobber_memory();
+        }, traffic(2 * N * sizeof(float)));
+        add("broadcast/scalar -> 16x256x256", [&] {
+            tensor::broadcast_inplace(dst.data(), 3, shape, src.data(), 1, scalar, tensor::Add{});
+            bench::clobber_memory();
+        }, traffic(2 * N * sizeof(float)));
+
+        // 8 阶同形状：全部维度合并为一行，与 3 阶同形状的吞吐量应当一致
+        std::size_t rank8[]{4, 4, 4, 4, 4, 4, 4, 64};
+        add("broadcast/same shape rank 8", [&] {
+            tensor::broadcast_inplace(dst.data(), 8, rank8, src.data(), 8, rank8, tensor::Add{});
+            bench::clobber_memory();
+        }, traffic(3 * N * sizeof(float)));
+    }
+    {
+        unsigned int shape[]{16, 16, 16, 16};
+        exercise23::Tensor<4, float> tensor(shape);
+        add("tensor/23 indexed sum 16^4", [&] {
+            auto sum = 0.f;
+            unsigned int i[4];
+            for (i[0] = 0; i[0] < 16; ++i[0]) {
+                for (i[1] = 0; i[1] < 16; ++i[1]) {
+                    for (i[2] = 0; i[2] < 16; ++i[2]) {
+                        for (i[3] = 0; i[3] < 16; ++i[3]) {
+                            sum += tensor[i];
+                        }
+                    }
+                }
+            }
+            bench::do_not_optimize(sum);
+        });
+    }
+    // 编译期形状：逐元素下标求和（整数加法，不受浮点加法延迟限制），与练习 23 的运行时形状对比；
+    // 全部固定时下标为常数乘加链，混合时部分长度从成员读取
+    {
+        unsigned int shape[]{16, 16, 16, 16};
+        exercise23::Tensor<4, int> dynamic(shape);
+        add("tensor/23 indexed sum int 16^4", [&] {
+            auto sum = 0;
+            unsigned int i[4];
+            for (i[0] = 0; i[0] < 16; ++i[0]) {
+                for (i[1] = 0; i[1] < 16; ++i[1]) {
+                    for (i[2] = 0; i[2] < 16; ++i[2]) {
+                        for (i[3] = 0; i[3] < 16; ++i[3]) {
+                            sum += dynamic[i];
+                        }
+                    }
+                }
+            }
+            bench::do_not_optimize(sum);
+        });
+        tensor::StaticTensor<int, 16, 16, 16, 16> fixed;
+        add("tensor/static indexed sum int 16^4", [&] {
+            auto sum = 0;
+            for (auto i0 = 0u; i0 < 16; ++i0) {
+                for (auto i1 = 0u; i1 < 16; ++i1) {
+                    for (auto i2 = 0u; i2 < 16; ++i2) {
+                        for (auto i3 = 0u; i3 < 16; ++i3) {
+                            sum += fixed(i0, i1, i2, i3);
+                        }
+                    }
+                }
+            }
+            bench::do_not_optimize(sum);
+        });
+        tensor::StaticTensor<int, tensor::DYNAMIC, 16, tensor::DYNAMIC, 16> mixed(16, 16);
+        add("tensor/static mixed indexed sum int 16^4", [&] {
+            auto sum = 0;
+            auto const &s = mixed.shape();
+            for (auto i0 = 0u; i0 < s.extent<0>(); ++i0) {
+                for (auto i1 = 0u; i1 < 16; ++i1) {
+                    for (auto i2 = 0u; i2 < s.extent<2>(); ++i2) {
+                        for (auto i3 = 0u; i3 < 16; ++i3) {
+                            sum += mixed(i0, i1, i2, i3);
+                        }
+                    }
+                }
+            }
+            bench::do_not_optimize(sum);
+        });
+    }
+    {
+        std::vector<exercise27::udim> shape{1, 3, 224, 224};
+        add("tensor/27 strides rank 4", [&] {
+            bench::do_not_optimize(shape);
+            bench::do_not_optimize(exercise27::strides(shape));
+        });
+    }
+
+    // 表达式模板：a + b * c - d 融合为一个循环，与逐步原地运算（三遍读写中间结果）对比，
+    // 两者都按有效流量（读 4 个操作数、写 1 个结果）计算吞吐量
+    {
+        constexpr std::size_t N = 1 << 20;
+        unsigned int shape[]{64, 128, 128};
+        std::vector<float> a(N, 1.f), b(N, 2.f), c(N, 3.f), d(N, 4.f), out(N);
+        add("expr/fused a + b * c - d 64x128x128", [&] {
+            tensor::assign(out.data(), 3, shape,
+                           tensor::lazy(a.data(), 3, shape) + tensor::lazy(b.data(), 3, shape) * tensor::lazy(c.data(), 3, shape) - tensor::lazy(d.data(), 3, shape));
+            bench::clobber_memory();
+        }, traffic(5 * N * sizeof(float)));
+        add("expr/temporaries a + b * c - d 64x128x128", [&] {
+            std::memcpy(out.data(), b.data(), N * sizeof(float));
+            tensor::broadcast_inplace(out.data(), 3, shape, c.data(), 3, shape, tensor::Mul{});
+            tensor::broadcast_inplace(out.data(), 3, shape, a.data(), 3, shape, tensor::Add{});
+            tensor::broadcast_inplace(out.data(), 3, shape, d.data(), 3, shape, tensor::Sub{});
+            bench::clobber_memory();
+        }, traffic(5 * N * sizeof(float)));
+        unsigned int row[]{128}, column[]{64, 128, 1};
+        add("expr/fused a * row + column 64x128x128", [&] {
+            tensor::assign(out.data(), 3, shape,
+                           tensor::lazy(a.data(), 3, shape) * tensor::lazy(b.data(), 1, row) + tensor::lazy(c.data(), 3, column));
+            bench::clobber_memory();
+        }, traffic(2 * N * sizeof(float)));
+    }
+
+    // 视图：切片、翻转、转置都不复制数据，直接交给核函数
+    {
+        constexpr std::size_t N = 1024;
+        unsigned int shape[]{N, N};
+        std::vector<float> a(N * N, 1.f), b(N * N, 2.f);
+        tensor::TensorView<float> va(a.data(), 2, shape), vb(b.data(), 2, shape);
+        add("view/add contiguous 1024x1024", [&] {
+            tensor::broadcast_inplace(va, vb, tensor::Add{});
+            bench::clobber_memory();
+        }, traffic(3 * N * N * sizeof(float)));
+        add("view/add flipped 1024x1024", [&] {
+            tensor::broadcast_inplace(va.flip(1), vb.flip(1), tensor::Add{});
+            bench::clobber_memory();
+        }, traffic(3 * N * N * sizeof(float)));
+        add("view/add transposed 1024x1024", [&] {
+            tensor::broadcast_inplace(va, vb.transpose(0, 1), tensor::Add{});
+            bench::clobber_memory();
+        }, traffic(3 * N * N * sizeof(float)));
+        add("view/add strided slice 1024x512", [&] {
+            tensor::broadcast_inplace(va.slice(1, 0, N, 2), vb.slice(1, 1, N, 2), tensor::Add{});
+            bench::clobber_memory();
+        }, traffic(3 * N * N / 2 * sizeof(float)));
+    }
+
+    // 逐元素迭代器：与 tensor/23 indexed sum int 16^4 相同的求和，改由 std::accumulate 走进位迭代器；
+    // 转置视图无法合并维度，每 16 个元素进位一次，与按相同顺序用下标访问对比。
+    // 下标循环的边界是常数，发布构建中编译器能把下标计算外提甚至向量化，迭代器的优势主要在调试构建和运行时形状上
+    {
+        unsigned int shape[]{16, 16, 16, 16};
+        exercise23::Tensor<4, int> a(shape), b(shape), out(shape);
+        add("iterator/accumulate int 16^4", [&] {
+            auto range = tensor::elements(a);
+            bench::do_not_optimize(std::accumulate(range.begin(), range.end(), 0));
+        });
+        add("iterator/23 indexed sum transposed order int 16^4", [&] {
+            auto sum = 0;
+            unsigned int i[4];
+            for (i[3] = 0; i[3] < 16; ++i[3]) {
+                for (i[1] = 0; i[1] < 16; ++i[1]) {
+                    for (i[2] = 0; i[2] < 16; ++i[2]) {
+                        for (i[0] = 0; i[0] < 16; ++i[0]) {
+                            sum += a[i];
+                        }
+                    }
+                }
+            }
+            bench::do_not_optimize(sum);
+        });
+        add("iterator/accumulate transposed int 16^4", [&] {
+            auto range = tensor::elements(tensor::view(a).transpose(0, 3));
+            bench::do_not_optimize(std::accumulate(range.begin(), range.end(), 0));
+        });
+        add("iterator/transform a + b^T int 16^4", [&] {
+            auto ra = tensor::elements(a), rb = tensor::elements(tensor::view(b).transpose(2, 3)), ro = tensor::elements(out);
+            std::transform(ra.begin(), ra.end(), rb.begin(), ro.begin(), std::plus<int>());
+            bench::clobber_memory();
+        }, traffic(3 * 16 * 16 * 16 * 16 * sizeof(int)));
+    }
+
+    // 归约：与逐行 std::accumulate / std::max_element、逐列累加的朴素循环对比
+    {
+        constexpr std::size_t N = 2048;
+        unsigned int shape[]{N, N}, rows[]{N, 1}, columns[]{1, N};
+        exercise23::Tensor<2, float> a(shape), by_row(rows), by_column(columns);
+        std::fill(a.data, a.data + N * N, 1.f);
+        add("reduce/naive accumulate all 2048x2048", [&] {
+            bench::do_not_optimize(std::accumulate(a.data, a.data + N * N, 0.f));
+        }, traffic(N * N * sizeof(float)));
+        add("reduce/sum all 2048x2048", [&] {
+            bench::do_not_optimize(tensor::sum(a));
+        }, traffic(N * N * sizeof(float)));
+        add("reduce/naive accumulate rows 2048x2048", [&] {
+            for (std::size_t i = 0; i < N; ++i) {
+                by_row.data[i] = std::accumulate(a.data + i * N, a.data + (i + 1) * N, 0.f);
+            }
+            bench::clobber_memory();
+        }, traffic(N * N * sizeof(float)));
+        add("reduce/sum axis 1 2048x2048", [&] {
+            tensor::sum(a, by_row);
+            bench::clobber_memory();
+        }, traffic(N * N * sizeof(float)));
+        add("reduce/naive accumulate columns 2048x2048", [&] {
+            for (std::size_t j = 0; j < N; ++j) {
+                auto sum = 0.f;
+                for (std::size_t i = 0; i < N; ++i) {
+                    sum += a.data[i * N + j];
+                }
+                by_column.data[j] = sum;
+            }
+            bench::clobber_memory();
+        }, traffic(N * N * sizeof(float)));
+        add("reduce/sum axis 0 2048x2048", [&] {
+            tensor::sum(a, by_column);
+            bench::clobber_memory();
+        }, traffic(N * N * sizeof(float)));
+        add("reduce/naive max_element rows 2048x2048", [&] {
+            for (std::size_t i = 0; i < N; ++i) {
+                by_row.data[i] = *std::max_element(a.data + i * N, a.data + (i + 1) * N);
+            }
+            bench::clobber_memory();
+        }, traffic(N * N * sizeof(float)));
+        add("reduce/max axis 1 2048x2048", [&] {
+            tensor::max(a, by_row);
+            bench::clobber_memory();
+        }, traffic(N * N * sizeof(float)));
+        std::vector<std::size_t> index(N);
+        tensor::TensorView<std::size_t> by_row_index(index.data(), 2, rows);
+        add("reduce/argmax axis 1 2048x2048", [&] {
+            tensor::argmax(a, by_row_index);
+            bench::clobber_memory();
+        }, traffic(N * N * sizeof(float)));
+        unsigned int cube[]{64, 64, 1024}, middle[]{1, 64, 1};
+        tensor::TensorView<float> va(a.data, 3, cube), vm(by_row.data, 3, middle);
+        add("reduce/mean axes 0, 2 64x64x1024", [&] {
+            tensor::mean(va, vm);
+            bench::clobber_memory();
+        }, traffic(N * N * sizeof(float)));
+    }
+
+    // 矩阵乘：分块、打包的 tensor::matmul 与朴素三重循环对比，方阵、矮胖、高瘦、转置和批量的情况
+    {
+        auto naive = [](float const *a, float const *b, float *c, std::size_t m, std::size_t k, std::size_t n) {
+            for (std::size_t i = 0; i < m; ++i) {
+                for (std::size_t j = 0; j < n; ++j) {
+                    auto sum = 0.f;
+                    for (std::size_t p = 0; p < k; ++p) {
+                        sum += a[i * k + p] * b[p * n + j];
+                    }
+                    c[i * n + j] = sum;
+                }
+            }
+        };
+        struct Shape {
+            unsigned int m, k, n;
+        };
+        for (auto [m, k, n] : {Shape{512, 512, 512}, Shape{16, 4096, 512}, Shape{2048, 64, 2048}}) {
+            unsigned int sa[]{m, k}, sb[]{k, n}, sc[]{m, n};
+            exercise23::Tensor<2, float> a(sa), b(sb), c(sc);
+            std::fill(a.data, a.data + m * k, 1.f);
+            std::fill(b.data, b.data + k * n, 2.f);
+            auto size = std::to_string(m) + "x" + std::to_string(k) + "x" + std::to_string(n);
+            auto flops = std::size_t{2} * m * k * n;
+            add("matmul/naive " + size, [&] {
+                naive(a.data, b.data, c.data, m, k, n);
+                bench::clobber_memory();
+            }, compute(flops, 5));
+            add("matmul/blocked " + size, [&] {
+                tensor::matmul(a, b, c);
+                bench::clobber_memory();
+            }, compute(flops));
+        }
+        {
+            constexpr unsigned int N = 512;
+            unsigned int shape[]{N, N};
+            exercise23::Tensor<2, float> a(shape), b(shape), c(shape);
+            add("matmul/blocked A^T B^T 512x512x512", [&] {
+                tensor::matmul(tensor::view(a).transpose(0, 1), tensor::view(b).transpose(0, 1), c);
+                bench::clobber_memory();
+            }, compute(std::size_t{2} * N * N * N));
+        }
+        {
+            constexpr unsigned int B = 64, N = 64;
+            unsigned int shape[]{B, N, N};
+            exercise23::Tensor<3, float> a(shape), b(shape), c(shape);
+            add("matmul/naive batched 64 x 64x64x64", [&] {
+                for (std::size_t i = 0; i < B; ++i) {
+                    naive(a.data + i * N * N, b.data + i * N * N, c.data + i * N * N, N, N, N);
+                }
+                bench::clobber_memory();
+            }, compute(std::size_t{2} * B * N * N * N, 20));
+            add("matmul/blocked batched 64 x 64x64x64", [&] {
+                tensor::matmul(a, b, c);
+                bench::clobber_memory();
+            }, compute(std::size_t{2} * B * N * N * N));
+        }
+    }
+
+    // 线程池：同一组运算分别限制为 1 到全部线程，观察扩展性
+    {
+        auto &pool = tensor::default_pool();
+        unsigned int small[]{1, 3, 224, 224}, large[]{16, 3, 224, 224}, channel[]{1, 3, 1, 1};
+        constexpr std::size_t S = 3 * 224 * 224, L = 16 * S;
+        std::vector<float> a(L, 1.f), b(L, 2.f), c(3, 3.f), out(L);
+        for (auto threads = 1u; threads <= pool.size(); ++threads) {
+            auto name = [threads](char const *what) {
+                return std::string("parallel/") + what + " x" + std::to_string(threads);
+            };
+            pool.set_limit(threads);
+            add(name("add 1x3x224x224"), [&] {
+                tensor::broadcast_inplace(a.data(), 4, small, b.data(), 4, small, tensor::Add{});
+                bench::clobber_memory();
+            }, traffic(3 * S * sizeof(float)));
+            add(name("add 16x3x224x224"), [&] {
+                tensor::broadcast_inplace(a.data(), 4, large, b.data(), 4, large, tensor::Add{});
+                bench::clobber_memory();
+            }, traffic(3 * L * sizeof(float)));
+            add(name("add channel 16x3x224x224"), [&] {
+                tensor::broadcast_inplace(a.data(), 4, large, c.data(), 4, channel, tensor::Add{});
+                bench::clobber_memory();
+            }, traffic(2 * L * sizeof(float)));
+            add(name("expr a * b + channel 16x3x224x224"), [&] {
+                tensor::assign(out.data(), 4, large,
+                               tensor::lazy(a.data(), 4, large) * tensor::lazy(b.data(), 4, large) + tensor::lazy(c.data(), 4, channel));
+                bench::clobber_memory();
+            }, traffic(3 * L * sizeof(float)));
+            add(name("sum 16x3x224x224"), [&] {
+                auto sum = pool.parallel_reduce(0, L, tensor::GRAIN, 0.0, [&](std::size_t begin, std::size_t end) {
+                    return std::accumulate(b.begin() + begin, b.begin() + end, 0.0);
+                }, std::plus<double>{});
+                bench::do_not_optimize(sum);
+            }, traffic(L * sizeof(float)));
+        }
+        pool.set_limit(pool.size());
+    }
+
+    // SIMD 核函数：在本机支持的每个指令集上分别测量，L1/L2 内的 16K 元素突出计算吞吐而非内存带宽
+    for (auto i = 0; i <= static_cast<int>(tensor::simd::detect_isa()); ++i) {
+        constexpr std::size_t N = 1 << 14;
+        auto isa = static_cast<tensor::simd::Isa>(i);
+        auto name = [isa](char const *what) {
+            return std::string("simd/") + tensor::simd::isa_name(isa) + ' ' + what;
+        };
+        constexpr auto ADD = static_cast<int>(tensor::simd::Op::Add),
+                       MUL = static_cast<int>(tensor::simd::Op::Mul),
+                       DIV = static_cast<int>(tensor::simd::Op::Div);
+        {
+            auto const &k = tensor::simd::kernels<float>(isa);
+            std::vector<float> a(N, 1.f), b(N, 2.f), c(N, 3.f), d(N);
+            add(name("add float 16K"), [&] {
+                k.binary[ADD](d.data(), a.data(), b.data(), N);
+                bench::clobber_memory();
+            }, traffic(3 * N * sizeof(float)));
+            add(name("div float 16K"), [&] {
+                k.binary[DIV](d.data(), a.data(), b.data(), N);
+                bench::clobber_memory();
+            }, traffic(3 * N * sizeof(float)));
+            add(name("add scalar float 16K"), [&] {
+                k.binary_scalar[ADD](d.data(), a.data(), 2.f, N);
+                bench::clobber_memory();
+            }, traffic(2 * N * sizeof(float)));
+            add(name("add rows float 4096x4"), [&] {
+                k.binary_rows[ADD](d.data(), a.data(), b.data(), N / 4, 4);
+                bench::clobber_memory();
+            }, traffic(2 * N * sizeof(float)));
+            add(name("fma float 16K"), [&] {
+                k.fma(d.data(), a.data(), b.data(), c.data(), N);
+                bench::clobber_memory();
+            }, traffic(4 * N * sizeof(float)));
+        }
+        {
+            auto const &k = tensor::simd::kernels<double>(isa);
+            std::vector<double> a(N, 1.), b(N, 2.), d(N);
+            add(name("mul double 16K"), [&] {
+                k.binary[MUL](d.data(), a.data(), b.data(), N);
+                bench::clobber_memory();
+            }, traffic(3 * N * sizeof(double)));
+        }
+        {
+            auto const &k = tensor::simd::kernels<int>(isa);
+            std::vector<int> a(N, 1), b(N, 2), d(N);
+            add(name("mul int 16K"), [&] {
+                k.binary[MUL](d.data(), a.data(), b.data(), N);
+                bench::clobber_memory();
+            }, traffic(3 * N * sizeof(int)));
+        }
+    }
+
+    // 有序映射：查找与覆盖写入
+    {
+        std::map<std::string, std::string> map;
+        std::vector<std::string> keys;
+        for (auto i = 0; i < 1000; ++i) {
+            keys.push_back("key" + std::to_string(i * 7919 % 1000));
+            exercise29::set(map, keys.back(), std::to_string(i));
+        }
+        std::size_t i = 0;
+        add("map/29 key_exists 1000", [&] {
+            bench::do_not_optimize(exercise29::key_exists(map, keys[i++ % keys.size()]));
+        });
+        std::string value = "value";
+        add("map/29 set existing 1000", [&] {
+            exercise29::set(map, keys[i++ % keys.size()], value);
+            bench::clobber_memory();
+        });
+    }
+
+    // 字符串：练习 28 中的拼接
+    {
+        using namespace std::string_literals;
+        auto hello = "Hello"s;
+        auto world = "world";
+        add("string/28 concat", [&] {
+            bench::do_not_optimize(hello);
+            bench::do_not_optimize(hello + ", " + world + '!');
+        });
+        auto long_hello = std::string(64, 'x');
+        add("string/28 concat 64 chars", [&] {
+            bench::do_not_optimize(long_hello);
+            bench::do_not_optimize(long_hello + ", " + world + '!');
+        });
+    }
+
+    bench::print_table(std::cout, results);
+    if (!history.empty() && !bench::append_history(history, results)) {
+        std::cerr << "Failed to append history: " << history << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -1,19 +1,413 @@
 ﻿#ifndef __EXERCISE_H__
 #define __EXERCISE_H__
 
+#include <cstdlib>
 #include <iostream>
 
-#define ASSERT(COND, MSG)                                                                         \
-    if (!(COND)) {                                                                                \
-        std::cerr << "\x1b[31mAssertion failed at line #" << __LINE__ << ": \x1b[0m" << std::endl \
-                  << std::endl                                                                    \
-                  << #COND << std::endl                                                           \
-                  << std::endl                                                                    \
-                  << "\x1b[34mMessage:\x1b[0m" << std::endl                                       \
-                  << std::endl                                                                    \
-                  << MSG << std::endl                                                             \
-                  << std::endl;                                                                   \
-        exit(1);                                                                                  \
+// 分支提示：断言几乎总是成立，失败分支放在冷路径上
+#if defined(__GNUC__) || defined(__clang__)
+#define EXERCISE_LIKELY(X) __builtin_expect(!!(X), 1)
+#define EXERCISE_UNLIKELY(X) __builtin_expect(!!(X), 0)
+#define EXERCISE_COLD __attribute__((cold, noinline))
+#elif defined(_MSC_VER)
+#define EXERCISE_LIKELY(X) (X)
+#define EXERCISE_UNLIKELY(X) (X)
+#define EXERCISE_COLD __declspec(noinline)
+#else
+#define EXERCISE_LIKELY(X) (X)
+#define EXERCISE_UNLIKELY(X) (X)
+#define EXERCISE_COLD
+#endif
+
+namespace exercise_detail {
+
+// 断言失败时输出位置、条件和消息并退出。
+// 消息由调用处的 lambda 写出，格式化代码随本函数留在冷路径上，不会内联进被检查的代码
+template<class Message>
+[[noreturn]] EXERCISE_COLD void assert_failed(int line, char const *cond, Message const &message) {
+    std::cerr << "\x1b[31mAssertion failed at line #" << line << ": \x1b[0m" << std::endl
+              << std::endl
+              << cond << std::endl
+              << std::endl
+              << "\x1b[34mMessage:\x1b[0m" << std::endl
+              << std::endl;
+    message(std::cerr);
+    std::cerr << std::endl
+              << std::endl;
+    std::exit(1);
+}
+
+}// namespace exercise_detail
+
+#define EXERCISE_CHECK(COND, MSG)                                                                             \
+    do {                                                                                                      \
+        if (EXERCISE_UNLIKELY(!(COND))) {                                                                     \
+            ::exercise_detail::assert_failed(__LINE__, #COND, [&](std::ostream &os_) { os_ << MSG; });         \
+        }                                                                                                     \
+    } while (0)
+
+// 条件只做类型检查，不求值，也不产生代码
+#define EXERCISE_IGNORE(COND) ((void) sizeof(!(COND)))
+
+// 断言分三级。练习代码只用 `ASSERT`，在默认的 release 模式下同样检查：
+// - `ASSERT` 始终检查，用于练习的判题和练习中的下标越界等检查；
+// - `DEBUG_ASSERT` 检查张量库（tensor/）热路径上的前置条件，定义 `NDEBUG`（release 模式）时不产生任何代码；
+// - `AUDIT_ASSERT` 检查代价高昂的不变量（如 tensor/broadcast.h 中输出与操作数互不重叠），只在定义 `EXERCISE_AUDIT`（`xmake f --audit=y`）时生效。
+#define ASSERT(COND, MSG) EXERCISE_CHECK(COND, MSG)
+
+#ifdef NDEBUG
+#define DEBUG_ASSERT(COND, MSG) EXERCISE_IGNORE(COND)
+#else
+#define DEBUG_ASSERT(COND, MSG) EXERCISE_CHECK(COND, MSG)
+#endif
+
+#ifdef EXERCISE_AUDIT
+#define AUDIT_ASSERT(COND, MSG) EXERCISE_CHECK(COND, MSG)
+#else
+#define AUDIT_ASSERT(COND, MSG) EXERCISE_IGNORE(COND)
+#endif
+
+// 微基准测试，只在 bench 目标（定义 `EXERCISE_BENCHMARK`）中引入，不增加练习的编译时间。
+// 用法：
+//     std::vector<bench::Result> results;
+//     results.push_back(bench::measure("name", [&] { bench::do_not_optimize(f(x)); }));
+//     bench::print_table(std::cout, results);
+#ifdef EXERCISE_BENCHMARK
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#if defined(__linux__)
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace bench {
+
+// 优化屏障：`value` 被视为已读取（或可能被修改），计算它的代码不会被消除或外提出循环
+template<class T>
+inline void do_not_optimize(T const &value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static_cast<void>(*static_cast<T const volatile *>(&value));
+#endif
+}
+
+template<class T>
+inline void do_not_optimize(T &value) {
+#if defined(__clang__)
+    asm volatile("" : "+r,m"(value) : : "memory");
+#elif defined(__GNUC__)
+    asm volatile("" : "+m,r"(value) : : "memory");
+#else
+    static_cast<void>(*static_cast<T volatile *>(&value));
+#endif
+}
+
+// 内存屏障：之前的写入都被视为对外可见，不会被合并或消除
+inline void clobber_memory() {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : : "memory");
+#elif defined(_MSC_VER)
+    _ReadWriteBarrier();
+#endif
+}
+
+// 时间戳计数器（x86 上为 rdtsc，频率恒定，与核心频率无关）；不支持的平台返回 0
+inline std::uint64_t cycles() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    return __rdtsc();
+#elif defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// 当前线程用户态的硬件性能计数器：周期、指令、L1D 读未命中、LLC 未命中、分支预测未命中。
+// 只在 Linux 上可用；内核拒绝访问（perf_event_paranoid）或不支持的事件读数为负
+class PerfCounters {
+public:
+    static constexpr int COUNT = 5;
+    enum { CYCLES, INSTRUCTIONS, L1D_MISSES, LLC_MISSES, BRANCH_MISSES };
+
+    PerfCounters() {
+#if defined(__linux__)
+        constexpr std::uint64_t CONFIGS[COUNT]{
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES,
+        };
+        for (auto i = 0; i < COUNT; ++i) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = i == L1D_MISSES ? PERF_TYPE_HW_CACHE : PERF_TYPE_HARDWARE;
+            attr.config = CONFIGS[i];
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fds_[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+        }
+#endif
+    }
+    ~PerfCounters() {
+#if defined(__linux__)
+        for (auto fd : fds_) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+#endif
+    }
+    PerfCounters(PerfCounters const &) = delete;
+    PerfCounters &operator=(PerfCounters const &) = delete;
+
+    bool available() const {
+        for (auto fd : fds_) {
+            if (fd >= 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void start() {
+#if defined(__linux__)
+        for (auto fd : fds_) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    void stop() {
+#if defined(__linux__)
+        for (auto fd : fds_) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+#endif
+    }
+
+    // 自 `start` 以来的计数，按多路复用的实际运行时间缩放
+    double read(int i) const {
+#if defined(__linux__)
+        std::uint64_t value[3];
+        if (fds_[i] >= 0 && ::read(fds_[i], value, sizeof(value)) == sizeof(value) && value[2] > 0) {
+            return static_cast<double>(value[0]) * static_cast<double>(value[1]) / static_cast<double>(value[2]);
+        }
+#endif
+        return -1;
+    }
+
+private:
+    int fds_[COUNT]{-1, -1, -1, -1, -1};
+};
+
+struct Options {
+    // 预热时间（秒）
+    double warmup = 0.01;
+    // 校准时使每个样本至少持续的时间（秒）
+    double sample_time = 1e-3;
+    unsigned int samples = 100;
+    // 采样期间读取硬件性能计数器
+    bool counters = true;
+    // 单次迭代读写的字节数，非零时据此计算吞吐量
+    std::size_t bytes = 0;
+    // 单次迭代的浮点运算次数，非零时据此计算算力
+    std::size_t flops = 0;
+};
+
+struct Result {
+    std::string name;
+    // 每个样本的迭代次数
+    std::uint64_t iterations = 0;
+    // 单次迭代耗时的中位数和 p99（纳秒），及单次迭代时间戳计数器的中位数
+    double median_ns = 0, p99_ns = 0, cycles = 0;
+    // 按中位数耗时计算的吞吐量（GB/s），未给出字节数时为负
+    double gbps = -1;
+    // 按中位数耗时计算的算力（GFLOP/s），未给出运算次数时为负
+    double gflops = -1;
+    // 采样期间的每周期指令数及每千条指令的 L1D、LLC、分支预测未命中数，不可用时为负
+    double ipc = -1, l1d_mpki = -1, llc_mpki = -1, branch_mpki = -1;
+    // 每个样本的单次迭代耗时（纳秒），升序
+    std::vector<double> samples_ns;
+};
+
+// 预热后倍增每个样本的迭代次数直到样本耗时不少于 `sample_time`，
+// 然后采集 `samples` 个样本，统计单次迭代耗时的分布
+template<class F>
+Result measure(std::string name, F &&f, Options const &options = {}) {
+    using Clock = std::chrono::steady_clock;
+    auto seconds = [](Clock::duration d) { return std::chrono::duration<double>(d).count(); };
+
+    for (auto start = Clock::now(); seconds(Clock::now() - start) < options.warmup;) {
+        f();
+    }
+
+    std::uint64_t iterations = 1;
+    for (;;) {
+        auto start = Clock::now();
+        for (auto i = iterations; i; --i) {
+            f();
+        }
+        auto elapsed = seconds(Clock::now() - start);
+        if (elapsed >= options.sample_time || iterations >= (std::uint64_t{1} << 40)) {
+            break;
+        }
+        // 按比例放大，最多 10 倍，避免单次测量的偶然误差导致迭代次数过大
+        auto scale = elapsed > 0 ? options.sample_time / elapsed * 1.2 : 10.0;
+        iterations = static_cast<std::uint64_t>(static_cast<double>(iterations) * std::min(std::max(scale, 2.0), 10.0));
+    }
+
+    std::vector<double> ns(std::max(options.samples, 1u)), ticks(ns.size());
+    PerfCounters counters;
+    if (options.counters) {
+        counters.start();
+    }
+    for (std::size_t s = 0; s < ns.size(); ++s) {
+        auto start = Clock::now();
+        auto c0 = cycles();
+        for (auto i = iterations; i; --i) {
+            f();
+        }
+        auto c1 = cycles();
+        ns[s] = seconds(Clock::now() - start) * 1e9 / static_cast<double>(iterations);
+        ticks[s] = static_cast<double>(c1 - c0) / static_cast<double>(iterations);
+    }
+    counters.stop();
+    std::sort(ns.begin(), ns.end());
+    std::sort(ticks.begin(), ticks.end());
+
+    Result ans;
+    if (options.counters) {
+        auto instructions = counters.read(PerfCounters::INSTRUCTIONS);
+        auto cpu_cycles = counters.read(PerfCounters::CYCLES);
+        auto per_kilo = [&](int i) {
+            auto value = counters.read(i);
+            return value >= 0 && instructions > 0 ? value * 1000 / instructions : -1;
+        };
+        ans.ipc = instructions >= 0 && cpu_cycles > 0 ? instructions / cpu_cycles : -1;
+        ans.l1d_mpki = per_kilo(PerfCounters::L1D_MISSES);
+        ans.llc_mpki = per_kilo(PerfCounters::LLC_MISSES);
+        ans.branch_mpki = per_kilo(PerfCounters::BRANCH_MISSES);
     }
+    ans.name = std::move(name);
+    ans.iterations = iterations;
+    ans.median_ns = ns[ns.size() / 2];
+    ans.p99_ns = ns[std::min(ns.size() - 1, (ns.size() * 99 + 99) / 100 - 1)];
+    ans.cycles = ticks[ticks.size() / 2];
+    if (options.bytes && ans.median_ns > 0) {
+        ans.gbps = static_cast<double>(options.bytes) / ans.median_ns;
+    }
+    if (options.flops && ans.median_ns > 0) {
+        ans.gflops = static_cast<double>(options.flops) / ans.median_ns;
+    }
+    ans.samples_ns = std::move(ns);
+    return ans;
+}
+
+inline void print_table(std::ostream &os, std::vector<Result> const &results) {
+    std::size_t width = 9;
+    // 所有用例都没有计数器读数时不输出计数器列
+    auto counters = false, throughput = false, compute = false;
+    for (auto const &result : results) {
+        width = std::max(width, result.name.size());
+        throughput = throughput || result.gbps >= 0;
+        compute = compute || result.gflops >= 0;
+        counters = counters || result.ipc >= 0 || result.l1d_mpki >= 0 || result.llc_mpki >= 0 || result.branch_mpki >= 0;
+    }
+    os << std::left << std::setw(width) << "benchmark" << std::right
+       << std::setw(14) << "iterations"
+       << std::setw(14) << "median ns"
+       << std::setw(14) << "p99 ns"
+       << std::setw(14) << "cycles";
+    if (throughput) {
+        os << std::setw(10) << "GB/s";
+    }
+    if (compute) {
+        os << std::setw(10) << "GFLOP/s";
+    }
+    if (counters) {
+        os << std::setw(8) << "IPC"
+           << std::setw(10) << "L1D MPKI"
+           << std::setw(10) << "LLC MPKI"
+           << std::setw(10) << "br MPKI";
+    }
+    os << std::endl;
+    auto print = [&os](int width, double value, int precision) {
+        if (value >= 0) {
+            os << std::setw(width) << std::setprecision(precision) << value;
+        } else {
+            os << std::setw(width) << '-';
+        }
+    };
+    for (auto const &result : results) {
+        os << std::left << std::setw(width) << result.name << std::right
+           << std::setw(14) << result.iterations
+           << std::fixed;
+        print(14, result.median_ns, 2);
+        print(14, result.p99_ns, 2);
+        print(14, result.cycles > 0 ? result.cycles : -1, 1);
+        if (throughput) {
+            print(10, result.gbps, 2);
+        }
+        if (compute) {
+            print(10, result.gflops, 2);
+        }
+        if (counters) {
+            print(8, result.ipc, 2);
+            print(10, result.l1d_mpki, 2);
+            print(10, result.llc_mpki, 2);
+            print(10, result.branch_mpki, 2);
+        }
+        os << std::defaultfloat << std::endl;
+    }
+}
+
+// 以 runner 的历史文件格式（run,kind,name,value）追加所有样本，
+// 之后可用 `xmake run summary --history <file> --compare-only` 与之前的运行比较
+inline bool append_history(std::string const &path, std::vector<Result> const &results) {
+    auto exists = static_cast<bool>(std::ifstream(path));
+    std::ofstream file(path, std::ios::out | std::ios::app);
+    if (!exists) {
+        file << "run,kind,name,value" << std::endl;
+    }
+    auto run = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    file.precision(9);
+    for (auto const &result : results) {
+        for (auto value : result.samples_ns) {
+            file << run << ",bench," << result.name << ',' << value << '\n';
+        }
+    }
+    file.flush();
+    return static_cast<bool>(file);
+}
+
+}// namespace bench
+
+#endif// EXERCISE_BENCHMARK
 
 #endif// __EXERCISE_H__
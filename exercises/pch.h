@@ -0,0 +1,19 @@
+﻿#ifndef __PCH_H__
+#define __PCH_H__
+
+// 预编译头：exercise.h 及练习中用到的标准库头文件。
+// 合并编译时练习被包含在命名空间中，练习引用的标准库头文件必须全部在这里先行引入。
+
+#include "exercise.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#endif// __PCH_H__
@@ -0,0 +1,13 @@
+﻿// 共享库模式下练习的 main 被重命名为 learn_exercise_main（见 xmake.lua），
+// 这里以 C 链接导出入口，供运行器的 fork 服务器 dlsym 后直接调用
+int learn_exercise_main(int argc, char **argv);
+
+#if defined(_WIN32)
+#define EXERCISE_EXPORT __declspec(dllexport)
+#else
+#define EXERCISE_EXPORT __attribute__((visibility("default")))
+#endif
+
+extern "C" EXERCISE_EXPORT int learn_exercise_entry(int argc, char **argv) {
+    return learn_exercise_main(argc, argv);
+}
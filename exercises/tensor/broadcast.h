@@ -0,0 +1,343 @@
+﻿#ifndef __TENSOR_BROADCAST_H__
+#define __TENSOR_BROADCAST_H__
+
+// 任意阶的广播逐元素运算。
+// 各操作数先按右对齐规则对齐到输出形状（长度为 1 的维度步长记为 0），
+// 再删去长度为 1 的维度、合并步长相容的相邻维度，使最内层循环尽可能长；
+// 最内层的一行按各操作数的步长交给连续或步长为 0（标量）的快速路径处理，
+// 元素为 float、double、int 时快速路径是按运行时指令集分派的 SIMD 核函数（见 simd.h）；
+// 大张量按元素切段，由线程池（见 parallel.h）并行处理。
+
+#include "../exercise.h"
+#include "parallel.h"
+#include "simd.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <type_traits>
+#include <vector>
+
+namespace tensor {
+
+constexpr unsigned int MAX_RANK = 16;
+
+// 对齐到同一输出形状的 K 个操作数上的多维循环，步长以元素计
+template<std::size_t K>
+struct Loop {
+    unsigned int rank = 0;
+    std::size_t extents[MAX_RANK]{};
+    std::ptrdiff_t strides[K][MAX_RANK]{};
+
+    std::size_t size() const {
+        std::size_t ans = 1;
+        for (auto i = 0u; i < rank; ++i) {
+            ans *= extents[i];
+        }
+        return ans;
+    }
+};
+
+// 行主序连续存储的步长，与练习 27 中 `strides()` 的计算相同
+template<class Dim>
+inline void contiguous_strides(unsigned int rank, Dim const *shape, std::ptrdiff_t *strides) {
+    std::ptrdiff_t stride = 1;
+    for (auto i = rank; i-- > 0;) {
+        strides[i] = stride;
+        stride *= static_cast<std::ptrdiff_t>(shape[i]);
+    }
+}
+
+// 把形状为 `shape`、步长为 `strides` 的操作数右对齐地广播到 `rank` 阶的 `out_shape`，写出对齐后的步长。
+// 对应维度长度必须相等或为 1，为 1 时步长记为 0
+template<class Dim, class OutDim>
+inline void broadcast_strides(unsigned int rank, OutDim const *out_shape,
+                              unsigned int src_rank, Dim const *shape, std::ptrdiff_t const *strides,
+                              std::ptrdiff_t *out) {
+    ASSERT(src_rank <= rank, "Cannot broadcast a tensor of rank " << src_rank << " to rank " << rank);
+    auto lead = rank - src_rank;
+    for (auto i = 0u; i < lead; ++i) {
+        out[i] = 0;
+    }
+    for (auto i = 0u; i < src_rank; ++i) {
+        auto d = static_cast<std::size_t>(shape[i]), o = static_cast<std::size_t>(out_shape[lead + i]);
+        ASSERT(d == o || d == 1, "Cannot broadcast dimension " << i << " of length " << d << " to " << o);
+        out[lead + i] = d == o && o != 1 ? strides[i] : 0;
+    }
+}
+
+// 删去长度为 1 的维度，并把所有操作数都满足 stride[p] == stride[d] * extent[d] 的相邻维度 p、d 合并为一维
+template<std::size_t K, class Dim>
+Loop<K> make_loop(unsigned int rank, Dim const *shape, std::array<std::ptrdiff_t const *, K> const &strides) {
+    ASSERT(rank <= MAX_RANK, "Rank " << rank << " exceeds " << MAX_RANK);
+    Loop<K> ans;
+    for (auto d = 0u; d < rank; ++d) {
+        auto extent = static_cast<std::size_t>(shape[d]);
+        if (extent == 1) {
+            continue;
+        }
+        if (extent == 0) {
+            ans.rank = 1;
+            ans.extents[0] = 0;
+            return ans;
+        }
+        auto merge = ans.rank > 0;
+        for (auto k = 0u; merge && k < K; ++k) {
+            merge = ans.strides[k][ans.rank - 1] == strides[k][d] * static_cast<std::ptrdiff_t>(extent);
+        }
+        if (merge) {
+            ans.extents[ans.rank - 1] *= extent;
+            for (auto k = 0u; k < K; ++k) {
+                ans.strides[k][ans.rank - 1] = strides[k][d];
+            }
+        } else {
+            ans.extents[ans.rank] = extent;
+            for (auto k = 0u; k < K; ++k) {
+                ans.strides[k][ans.rank] = strides[k][d];
+            }
+            ++ans.rank;
+        }
+    }
+    // 标量：视为长度为 1 的一维
+    if (ans.rank == 0) {
+        ans.rank = 1;
+        ans.extents[0] = 1;
+    }
+    return ans;
+}
+
+// 为逐元素运算调整遍历顺序：第一个操作数（输出）上步长为负的维度连同其他操作数一起反向遍历，
+// 再按输出步长的绝对值从大到小稳定地重排各维。逐元素运算的结果与遍历顺序无关，
+// 这样输出为转置或翻转的视图时，最内层仍是输出上最密的维度，并能合并出尽可能长的行
+template<std::size_t K, class T>
+void normalize_axes(unsigned int rank, std::size_t *extents, std::ptrdiff_t (&strides)[K][MAX_RANK], std::array<T *, K> &ptrs) {
+    for (auto d = 0u; d < rank; ++d) {
+        if (strides[0][d] < 0 && extents[d] > 0) {
+            for (auto k = 0u; k < K; ++k) {
+                ptrs[k] += strides[k][d] * static_cast<std::ptrdiff_t>(extents[d] - 1);
+                strides[k][d] = -strides[k][d];
+            }
+        }
+    }
+    for (auto i = 1u; i < rank; ++i) {
+        for (auto j = i; j > 0 && strides[0][j - 1] < strides[0][j]; --j) {
+            std::swap(extents[j - 1], extents[j]);
+            for (auto k = 0u; k < K; ++k) {
+                std::swap(strides[k][j - 1], strides[k][j]);
+            }
+        }
+    }
+}
+
+// 按行主序依次对 [begin, end) 中的元素所在的每一段最内层行调用 `row(ptrs, n, strides)`，
+// `ptrs` 为该段起点，首尾两段可以不是完整的行；外层下标以进位方式递增
+template<std::size_t K, class T, class Row>
+void for_each_row(Loop<K> const &loop, std::array<T *, K> ptrs, Row &&row, std::size_t begin, std::size_t end) {
+    auto const inner = loop.rank - 1;
+    auto const n = loop.extents[inner];
+    if (n == 0 || begin >= end) {
+        return;
+    }
+    std::array<std::ptrdiff_t, K> inner_strides;
+    for (auto k = 0u; k < K; ++k) {
+        inner_strides[k] = loop.strides[k][inner];
+    }
+    std::size_t index[MAX_RANK]{};
+    auto rest = begin;
+    for (auto d = loop.rank; d-- > 0;) {
+        index[d] = rest % loop.extents[d];
+        rest /= loop.extents[d];
+        for (auto k = 0u; k < K; ++k) {
+            ptrs[k] += loop.strides[k][d] * static_cast<std::ptrdiff_t>(index[d]);
+        }
+    }
+    for (auto remaining = end - begin;;) {
+        auto m = std::min(n - index[inner], remaining);
+        row(ptrs, m, inner_strides);
+        if ((remaining -= m) == 0) {
+            return;
+        }
+        for (auto k = 0u; k < K; ++k) {
+            ptrs[k] -= inner_strides[k] * static_cast<std::ptrdiff_t>(index[inner]);
+        }
+        index[inner] = 0;
+        // 进位：最内的外层维度加一，到头则归零并向更外一维进位
+        auto d = inner;
+        for (;;) {
+            if (d == 0) {
+                return;
+            }
+            --d;
+            for (auto k = 0u; k < K; ++k) {
+                ptrs[k] += loop.strides[k][d];
+            }
+            if (++index[d] < loop.extents[d]) {
+                break;
+            }
+            for (auto k = 0u; k < K; ++k) {
+                ptrs[k] -= loop.strides[k][d] * static_cast<std::ptrdiff_t>(loop.extents[d]);
+            }
+            index[d] = 0;
+        }
+    }
+}
+
+template<std::size_t K, class T, class Row>
+void for_each_row(Loop<K> const &loop, std::array<T *, K> ptrs, Row &&row) {
+    for_each_row(loop, ptrs, row, 0, loop.size());
+}
+
+// 第一个操作数（输出）的不同下标指向不同的元素，其他操作数的每个元素要么不在输出上，
+// 要么就是同一下标的输出元素（原地运算）。需要收集并排序所有元素的地址，只用于 `AUDIT_ASSERT`
+template<std::size_t K, class T>
+bool is_disjoint(Loop<K> const &loop, std::array<T *, K> const &ptrs) {
+    std::vector<std::uintptr_t> addresses[K];
+    for_each_row(loop, ptrs, [&](auto const &p, std::size_t n, auto const &s) {
+        for (auto k = 0u; k < K; ++k) {
+            for (std::size_t i = 0; i < n; ++i) {
+                addresses[k].push_back(reinterpret_cast<std::uintptr_t>(p[k] + static_cast<std::ptrdiff_t>(i) * s[k]));
+            }
+        }
+    });
+    auto out = addresses[0];
+    std::sort(out.begin(), out.end());
+    if (std::adjacent_find(out.begin(), out.end()) != out.end()) {
+        return false;
+    }
+    for (auto k = 1u; k < K; ++k) {
+        for (std::size_t i = 0; i < addresses[k].size(); ++i) {
+            auto a = addresses[k][i];
+            if (a != addresses[0][i] && std::binary_search(out.begin(), out.end(), a)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// 同 `for_each_row`，元素不少于两个粒度时按元素下标切段交给线程池并行处理
+template<std::size_t K, class T, class Row>
+void parallel_for_each_row(Loop<K> const &loop, std::array<T *, K> ptrs, Row &&row, std::size_t grain = GRAIN) {
+    auto const size = loop.size();
+    if (size < 2 * grain) {
+        for_each_row(loop, ptrs, row, 0, size);
+        return;
+    }
+    default_pool().parallel_for(0, size, grain, [&](std::size_t begin, std::size_t end) {
+        for_each_row(loop, ptrs, row, begin, end);
+    });
+}
+
+struct Add {
+    static constexpr simd::Op kind = simd::Op::Add;
+    template<class T>
+    T operator()(T a, T b) const { return a + b; }
+};
+struct Sub {
+    static constexpr simd::Op kind = simd::Op::Sub;
+    template<class T>
+    T operator()(T a, T b) const { return a - b; }
+};
+struct Mul {
+    static constexpr simd::Op kind = simd::Op::Mul;
+    template<class T>
+    T operator()(T a, T b) const { return a * b; }
+};
+struct Div {
+    static constexpr simd::Op kind = simd::Op::Div;
+    template<class T>
+    T operator()(T a, T b) const { return a / b; }
+};
+
+// 一行上的 dst[i] = op(dst[i], src[i])：连续、标量广播和一般步长三种情况
+template<class T, class Op>
+inline void apply_row(T *dst, std::ptrdiff_t dst_stride, T const *src, std::ptrdiff_t src_stride, std::size_t n, Op op) {
+    if (dst_stride == 1 && src_stride == 1) {
+        for (std::size_t i = 0; i < n; ++i) {
+            dst[i] = op(dst[i], src[i]);
+        }
+    } else if (dst_stride == 1 && src_stride == 0) {
+        auto const value = *src;
+        for (std::size_t i = 0; i < n; ++i) {
+            dst[i] = op(dst[i], value);
+        }
+    } else {
+        for (std::size_t i = 0; i < n; ++i) {
+            dst[i * dst_stride] = op(dst[i * dst_stride], src[i * src_stride]);
+        }
+    }
+}
+
+// 运算有对应的 SIMD 核函数
+template<class Op, class = void>
+constexpr bool has_kernel = false;
+template<class Op>
+constexpr bool has_kernel<Op, std::void_t<decltype(Op::kind)>> = true;
+
+// dst = op(dst, src)，`src` 单向广播到 `dst` 的形状；两者的步长以元素计，可以为负（翻转）或 0（广播）。
+// `dst` 不能与 `src` 部分重叠，也不能含有步长为 0 的维度
+template<class T, class Op, class Dim, class SrcDim>
+void broadcast_inplace(T *dst, unsigned int rank, Dim const *shape, std::ptrdiff_t const *dst_strides,
+                       T const *src, unsigned int src_rank, SrcDim const *src_shape, std::ptrdiff_t const *src_strides, Op op) {
+    ASSERT(rank <= MAX_RANK, "Rank " << rank << " exceeds " << MAX_RANK);
+    std::size_t extents[MAX_RANK];
+    std::ptrdiff_t strides[2][MAX_RANK];
+    for (auto i = 0u; i < rank; ++i) {
+        extents[i] = static_cast<std::size_t>(shape[i]);
+        strides[0][i] = dst_strides[i];
+    }
+    broadcast_strides(rank, shape, src_rank, src_shape, src_strides, strides[1]);
+    std::array<T *, 2> ptrs{dst, const_cast<T *>(src)};
+    normalize_axes(rank, extents, strides, ptrs);
+    auto loop = make_loop<2>(rank, extents, {strides[0], strides[1]});
+    AUDIT_ASSERT(is_disjoint(loop, ptrs), "The destination overlaps itself or partially overlaps the source");
+    if constexpr (simd::supported<T> && has_kernel<Op>) {
+        auto const &kernels = simd::kernels<T>(simd::active_isa());
+        auto const k = static_cast<int>(Op::kind);
+        auto const inner = loop.rank - 1;
+        auto const cols = loop.extents[inner];
+        // 最内两维是一行向量广播到连续的多行：整块交给 binary_rows，行很短时也不必逐行进出核函数
+        if (loop.rank >= 2 &&
+            loop.strides[0][inner] == 1 && loop.strides[1][inner] == 1 &&
+            loop.strides[0][inner - 1] == static_cast<std::ptrdiff_t>(cols) && loop.strides[1][inner - 1] == 0) {
+            auto rows_loop = loop;
+            rows_loop.rank -= 1;
+            auto f = kernels.binary_rows[k];
+            parallel_for_each_row(rows_loop, ptrs, [f, cols](auto const &p, std::size_t rows, auto const &) {
+                f(p[0], p[0], p[1], rows, cols);
+            }, std::max<std::size_t>(GRAIN / cols, 1));
+            return;
+        }
+        auto binary = kernels.binary[k];
+        auto binary_scalar = kernels.binary_scalar[k];
+        parallel_for_each_row(loop, ptrs, [=](auto const &p, std::size_t n, auto const &s) {
+            if (s[0] == 1 && s[1] == 1) {
+                binary(p[0], p[0], p[1], n);
+            } else if (s[0] == 1 && s[1] == 0) {
+                binary_scalar(p[0], p[0], *p[1], n);
+            } else {
+                apply_row(p[0], s[0], static_cast<T const *>(p[1]), s[1], n, op);
+            }
+        });
+        return;
+    }
+    parallel_for_each_row(loop, ptrs, [op](auto const &p, std::size_t n, auto const &s) {
+        apply_row(p[0], s[0], static_cast<T const *>(p[1]), s[1], n, op);
+    });
+}
+
+// 两者都是行主序连续存储
+template<class T, class Op, class Dim, class SrcDim>
+void broadcast_inplace(T *dst, unsigned int rank, Dim const *shape,
+                       T const *src, unsigned int src_rank, SrcDim const *src_shape, Op op) {
+    std::ptrdiff_t dst_strides[MAX_RANK], src_strides[MAX_RANK];
+    ASSERT(rank <= MAX_RANK && src_rank <= MAX_RANK, "Rank " << std::max(rank, src_rank) << " exceeds " << MAX_RANK);
+    contiguous_strides(rank, shape, dst_strides);
+    contiguous_strides(src_rank, src_shape, src_strides);
+    broadcast_inplace(dst, rank, shape, dst_strides, src, src_rank, src_shape, src_strides, op);
+}
+
+}// namespace tensor
+
+#endif// __TENSOR_BROADCAST_H__
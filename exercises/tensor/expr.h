@@ -0,0 +1,217 @@
+﻿#ifndef __TENSOR_EXPR_H__
+#define __TENSOR_EXPR_H__
+
+// 逐元素运算的表达式模板。
+// `lazy(a) + lazy(b) * lazy(c) - lazy(d)` 只构造描述计算的轻量对象，不产生中间张量；
+// `assign(out, expression)` 把各操作数单向广播到 `out` 的形状后，在一个融合的循环中求值，
+// 每个操作数只读一遍，结果只写一遍；大张量由线程池并行求值。
+
+#include "view.h"
+#include <algorithm>
+#include <type_traits>
+
+namespace tensor {
+
+template<class E>
+struct Expr {
+    E const &self() const { return static_cast<E const &>(*this); }
+};
+
+// 叶子：一个张量视图。各成员函数的模板参数 `I` 是它在求值时的操作数编号
+template<class T>
+struct Leaf : Expr<Leaf<T>> {
+    using value_type = T;
+    static constexpr std::size_t leaves = 1;
+
+    TensorView<T const> view;
+
+    explicit Leaf(TensorView<T const> const &view_) : view(view_) {}
+
+    // 写出对齐到输出形状的步长和数据指针
+    template<std::size_t I, std::size_t K, class Dim>
+    void bind(unsigned int out_rank, Dim const *out_shape, std::ptrdiff_t (&strides)[K][MAX_RANK], std::array<T *, K> &ptrs) const {
+        broadcast_strides(out_rank, out_shape, view.rank, view.shape, view.strides, strides[I]);
+        ptrs[I] = const_cast<T *>(view.origin());
+    }
+
+    template<std::size_t I, std::size_t K>
+    T eval(std::array<T *, K> const &p, std::array<std::ptrdiff_t, K> const &s, std::size_t i) const {
+        return p[I][static_cast<std::ptrdiff_t>(i) * s[I]];
+    }
+
+    // 所有操作数在最内层都连续时的求值，下标就是偏移，便于编译器向量化
+    template<std::size_t I, std::size_t K>
+    T eval_contiguous(std::array<T *, K> const &p, std::size_t i) const {
+        return p[I][i];
+    }
+};
+
+// 标量：参与运算的常数，不占操作数编号
+template<class T>
+struct Scalar : Expr<Scalar<T>> {
+    using value_type = T;
+    static constexpr std::size_t leaves = 0;
+
+    T value;
+
+    explicit Scalar(T value_) : value(value_) {}
+
+    template<std::size_t I, std::size_t K, class Dim>
+    void bind(unsigned int, Dim const *, std::ptrdiff_t (&)[K][MAX_RANK], std::array<T *, K> &) const {}
+
+    template<std::size_t I, std::size_t K>
+    T eval(std::array<T *, K> const &, std::array<std::ptrdiff_t, K> const &, std::size_t) const {
+        return value;
+    }
+
+    template<std::size_t I, std::size_t K>
+    T eval_contiguous(std::array<T *, K> const &, std::size_t) const {
+        return value;
+    }
+};
+
+template<class Op, class L, class R>
+struct Binary : Expr<Binary<Op, L, R>> {
+    static_assert(std::is_same<typename L::value_type, typename R::value_type>::value,
+                  "Operands of a tensor expression must have the same element type");
+    using value_type = typename L::value_type;
+    static constexpr std::size_t leaves = L::leaves + R::leaves;
+
+    L l;
+    R r;
+
+    Binary(L l_, R r_) : l(l_), r(r_) {}
+
+    template<std::size_t I, std::size_t K, class Dim>
+    void bind(unsigned int out_rank, Dim const *out_shape, std::ptrdiff_t (&strides)[K][MAX_RANK], std::array<value_type *, K> &ptrs) const {
+        l.template bind<I>(out_rank, out_shape, strides, ptrs);
+        r.template bind<I + L::leaves>(out_rank, out_shape, strides, ptrs);
+    }
+
+    template<std::size_t I, std::size_t K>
+    value_type eval(std::array<value_type *, K> const &p, std::array<std::ptrdiff_t, K> const &s, std::size_t i) const {
+        return Op{}(l.template eval<I>(p, s, i), r.template eval<I + L::leaves>(p, s, i));
+    }
+
+    template<std::size_t I, std::size_t K>
+    value_type eval_contiguous(std::array<value_type *, K> const &p, std::size_t i) const {
+        return Op{}(l.template eval_contiguous<I>(p, i), r.template eval_contiguous<I + L::leaves>(p, i));
+    }
+};
+
+// 连续存储的张量作为表达式的叶子
+template<class T, class Dim>
+Leaf<T> lazy(T const *data, unsigned int rank, Dim const *shape) {
+    return Leaf<T>(TensorView<T const>(data, rank, shape));
+}
+
+// 视图或任何带有数组成员 `shape` 和指针成员 `data` 的连续张量，如练习中的 `Tensor4D<T>` 和 `Tensor<N, T>`
+template<class Tensor>
+auto lazy(Tensor const &t) -> Leaf<std::remove_const_t<typename decltype(view(t))::value_type>> {
+    return Leaf<std::remove_const_t<typename decltype(view(t))::value_type>>(view(t));
+}
+
+#define TENSOR_EXPR_OPERATOR(SYMBOL, OP)                                                        \
+    template<class L, class R>                                                                  \
+    Binary<OP, L, R> operator SYMBOL(Expr<L> const &l, Expr<R> const &r) {                      \
+        return {l.self(), r.self()};                                                            \
+    }                                                                                           \
+    template<class L>                                                                           \
+    Binary<OP, L, Scalar<typename L::value_type>> operator SYMBOL(Expr<L> const &l,             \
+                                                                  typename L::value_type r) {   \
+        return {l.self(), Scalar<typename L::value_type>(r)};                                   \
+    }                                                                                           \
+    template<class R>                                                                           \
+    Binary<OP, Scalar<typename R::value_type>, R> operator SYMBOL(typename R::value_type l,     \
+                                                                  Expr<R> const &r) {           \
+        return {Scalar<typename R::value_type>(l), r.self()};                                   \
+    }
+
+TENSOR_EXPR_OPERATOR(+, Add)
+TENSOR_EXPR_OPERATOR(-, Sub)
+TENSOR_EXPR_OPERATOR(*, Mul)
+TENSOR_EXPR_OPERATOR(/, Div)
+
+#undef TENSOR_EXPR_OPERATOR
+
+// out = expression：所有操作数单向广播到 `out` 的形状，在一个融合的循环中求值。
+// `out` 的步长以元素计，可以为负；`out` 可以是表达式的操作数之一（两者完全相同时逐元素原地更新），
+// 但不能与其他操作数部分重叠
+template<class T, class Dim, class E>
+void assign(T *out, unsigned int rank, Dim const *shape, std::ptrdiff_t const *out_strides, Expr<E> const &expression) {
+    static_assert(std::is_same<typename E::value_type, T>::value, "The expression must produce the element type of the output");
+    constexpr auto K = E::leaves + 1;
+    ASSERT(rank <= MAX_RANK, "Rank " << rank << " exceeds " << MAX_RANK);
+    auto const &e = expression.self();
+    std::size_t extents[MAX_RANK];
+    std::ptrdiff_t strides[K][MAX_RANK];
+    std::array<T *, K> ptrs{out};
+    for (auto i = 0u; i < rank; ++i) {
+        extents[i] = static_cast<std::size_t>(shape[i]);
+        strides[0][i] = out_strides[i];
+    }
+    e.template bind<1>(rank, shape, strides, ptrs);
+    normalize_axes(rank, extents, strides, ptrs);
+    std::array<std::ptrdiff_t const *, K> operands;
+    for (std::size_t k = 0; k < K; ++k) {
+        operands[k] = strides[k];
+    }
+    auto loop = make_loop<K>(rank, extents, operands);
+    AUDIT_ASSERT(is_disjoint(loop, ptrs), "The output overlaps itself or partially overlaps an operand");
+    parallel_for_each_row(loop, ptrs, [&e](auto const &p, std::size_t n, auto const &s) {
+        // 最内层各操作数的步长都是 1 或 0 时，把步长为 0 的操作数在缓冲中展开成一段连续的值，
+        // 整行按连续的情况分块求值，使最内层循环可以向量化
+        auto unit = s[0] == 1, broadcast = false;
+        for (auto stride : s) {
+            unit = unit && (stride == 1 || stride == 0);
+            broadcast = broadcast || stride == 0;
+        }
+        if (unit && !broadcast) {
+            for (std::size_t i = 0; i < n; ++i) {
+                p[0][i] = e.template eval_contiguous<1>(p, i);
+            }
+        } else if (unit) {
+            constexpr std::size_t BLOCK = 256;
+            T buffer[K][BLOCK];
+            for (std::size_t k = 0; k < K; ++k) {
+                if (s[k] == 0) {
+                    std::fill_n(buffer[k], std::min(n, BLOCK), *p[k]);
+                }
+            }
+            std::array<T *, K> q;
+            for (std::size_t start = 0; start < n; start += BLOCK) {
+                auto m = std::min(n - start, BLOCK);
+                for (std::size_t k = 0; k < K; ++k) {
+                    q[k] = s[k] == 0 ? buffer[k] : p[k] + start;
+                }
+                for (std::size_t i = 0; i < m; ++i) {
+                    q[0][i] = e.template eval_contiguous<1>(q, i);
+                }
+            }
+        } else {
+            for (std::size_t i = 0; i < n; ++i) {
+                p[0][static_cast<std::ptrdiff_t>(i) * s[0]] = e.template eval<1>(p, s, i);
+            }
+        }
+    });
+}
+
+// 行主序连续存储的 `out`
+template<class T, class Dim, class E>
+void assign(T *out, unsigned int rank, Dim const *shape, Expr<E> const &expression) {
+    std::ptrdiff_t strides[MAX_RANK];
+    ASSERT(rank <= MAX_RANK, "Rank " << rank << " exceeds " << MAX_RANK);
+    contiguous_strides(rank, shape, strides);
+    assign(out, rank, shape, strides, expression);
+}
+
+// `out` 为视图或带有 `shape` 和 `data` 成员的连续张量
+template<class Tensor, class E>
+void assign(Tensor &&out, Expr<E> const &expression) {
+    auto v = view(out);
+    assign(v.origin(), v.rank, v.shape, v.strides, expression);
+}
+
+}// namespace tensor
+
+#endif// __TENSOR_EXPR_H__
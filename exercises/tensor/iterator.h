@@ -0,0 +1,102 @@
+﻿#ifndef __TENSOR_ITERATOR_H__
+#define __TENSOR_ITERATOR_H__
+
+// 按行主序逐元素遍历视图的迭代器，可直接用于 std::transform、std::accumulate 等标准库算法。
+// 遍历前先合并维度（与核函数相同的 make_loop），迭代器只在最内层维度上移动指针，
+// 到头时才按进位规则更新外层下标，不必每个元素重新计算下标与步长的点积和越界检查。
+// 任意步长（包括负步长和广播的 0 步长）的视图都可以遍历。
+
+#include "view.h"
+#include <iterator>
+
+namespace tensor {
+
+template<class T>
+class ElementIterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::remove_const_t<T>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = T *;
+    using reference = T &;
+
+    ElementIterator() = default;
+    ElementIterator(Loop<1> const *loop, T *ptr, std::size_t position)
+        : loop_(loop), ptr_(ptr), position_(position),
+          step_(loop->strides[0][loop->rank - 1]), row_end_(position + loop->extents[loop->rank - 1]), index_{} {}
+
+    reference operator*() const { return *ptr_; }
+    pointer operator->() const { return ptr_; }
+
+    ElementIterator &operator++() {
+        ptr_ += step_;
+        if (EXERCISE_LIKELY(++position_ != row_end_)) {
+            return *this;
+        }
+        carry();
+        return *this;
+    }
+    ElementIterator operator++(int) {
+        auto ans = *this;
+        ++*this;
+        return ans;
+    }
+
+    // 行主序中的序号
+    std::size_t position() const { return position_; }
+
+    // 只比较序号，因此来自同一视图的不同 Elements 对象的迭代器也可以相互比较
+    friend bool operator==(ElementIterator const &a, ElementIterator const &b) { return a.position_ == b.position_; }
+    friend bool operator!=(ElementIterator const &a, ElementIterator const &b) { return a.position_ != b.position_; }
+
+private:
+    // 最内层走完一行：回到行首，外层按进位规则前进；最外层也到头时即为末尾，回到起点
+    void carry() {
+        auto d = loop_->rank - 1;
+        ptr_ -= step_ * static_cast<std::ptrdiff_t>(loop_->extents[d]);
+        row_end_ += loop_->extents[d];
+        while (d-- > 0) {
+            ptr_ += loop_->strides[0][d];
+            if (++index_[d] < loop_->extents[d]) {
+                return;
+            }
+            ptr_ -= loop_->strides[0][d] * static_cast<std::ptrdiff_t>(loop_->extents[d]);
+            index_[d] = 0;
+        }
+    }
+
+    Loop<1> const *loop_ = nullptr;
+    T *ptr_ = nullptr;
+    std::size_t position_ = 0;
+    // 最内层的步长和本行末尾的序号，热路径只读写这几个成员
+    std::ptrdiff_t step_ = 0;
+    std::size_t row_end_ = 0;
+    // 外层各维的下标，最内层不使用
+    std::size_t index_[MAX_RANK];
+};
+
+// 视图中全部元素构成的范围，迭代器引用其中合并后的循环，范围须比迭代器活得长
+template<class T>
+class Elements {
+public:
+    explicit Elements(TensorView<T> const &view)
+        : loop_(make_loop<1>(view.rank, view.shape, {view.strides})), origin_(view.origin()) {}
+
+    ElementIterator<T> begin() const { return {&loop_, origin_, 0}; }
+    ElementIterator<T> end() const { return {&loop_, origin_, loop_.size()}; }
+    std::size_t size() const { return loop_.size(); }
+
+private:
+    Loop<1> loop_;
+    T *origin_;
+};
+
+// 视图或带有 `shape` 和 `data` 成员的连续张量的全部元素
+template<class Tensor>
+auto elements(Tensor &&t) -> Elements<typename decltype(view(t))::value_type> {
+    return Elements<typename decltype(view(t))::value_type>(view(t));
+}
+
+}// namespace tensor
+
+#endif// __TENSOR_ITERATOR_H__
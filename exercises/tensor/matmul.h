@@ -0,0 +1,230 @@
+﻿#ifndef __TENSOR_MATMUL_H__
+#define __TENSOR_MATMUL_H__
+
+// 矩阵乘与批量矩阵乘。
+// 按 Goto 的分块方法：B 的 kc×nc 块和 A 的 mc×kc 块分别打包成寄存器块宽度的面板，打包时按任意步长读取，
+// 转置的视图不需要先复制；微核只顺序读取打包好的连续内存，kc、mc、nc 分别按 L1、L2 和末级缓存的容量选取。
+// 微核在 simd_kernels.h 中，把 C 的 gemm_mr×gemm_nr 块留在寄存器中累加。
+// 任务按 A 的行块和 C 的列段切分给线程池；批足够多时改为按批切分，每个矩阵在一个线程上计算。
+
+#include "storage.h"
+#include "view.h"
+
+namespace tensor {
+
+// 每个线程至少分到的乘加次数
+constexpr std::size_t GEMM_GRAIN = 1 << 18;
+// B 的一个微面板（kc×nr）、A 的一块（mc×kc）和 B 的一块（kc×nc）的目标字节数
+constexpr std::size_t GEMM_L1 = 16 << 10, GEMM_L2 = 256 << 10, GEMM_L3 = 4 << 20;
+// 边缘寄存器块的临时缓冲能容纳的元素数
+constexpr std::size_t GEMM_MAX_TILE = 256;
+
+// 一个矩阵：起点、行列数和行列步长（以元素计）
+template<class T>
+struct Matrix {
+    T *data;
+    std::size_t rows, cols;
+    std::ptrdiff_t row_stride, col_stride;
+
+    T &operator()(std::size_t i, std::size_t j) const {
+        return data[static_cast<std::ptrdiff_t>(i) * row_stride + static_cast<std::ptrdiff_t>(j) * col_stride];
+    }
+
+    // 从 (i, j) 开始的 rows_×cols_ 子矩阵
+    Matrix block(std::size_t i, std::size_t j, std::size_t rows_, std::size_t cols_) const {
+        return {&(*this)(i, j), rows_, cols_, row_stride, col_stride};
+    }
+};
+
+// A 的一块按 mr 行一组打包：组内依次存放每一步的 mr 个元素，不足 mr 行的补 0
+template<class T>
+void pack_a(Matrix<T const> const &a, std::size_t mr, T *out) {
+    for (std::size_t i0 = 0; i0 < a.rows; i0 += mr) {
+        auto m = std::min(mr, a.rows - i0);
+        for (std::size_t p = 0; p < a.cols; ++p) {
+            std::size_t i = 0;
+            for (; i < m; ++i) {
+                *out++ = a(i0 + i, p);
+            }
+            for (; i < mr; ++i) {
+                *out++ = T{};
+            }
+        }
+    }
+}
+
+// B 的一块按 nr 列一组打包：组内依次存放每一步的 nr 个元素，不足 nr 列的补 0
+template<class T>
+void pack_b(Matrix<T const> const &b, std::size_t nr, T *out) {
+    for (std::size_t j0 = 0; j0 < b.cols; j0 += nr) {
+        auto n = std::min(nr, b.cols - j0);
+        for (std::size_t p = 0; p < b.rows; ++p) {
+            std::size_t j = 0;
+            for (; j < n; ++j) {
+                *out++ = b(p, j0 + j);
+            }
+            for (; j < nr; ++j) {
+                *out++ = T{};
+            }
+        }
+    }
+}
+
+// 没有 SIMD 核函数的元素类型：按行累加，最内层顺序访问 B 和 C 的一行
+template<class T>
+void gemm_naive(Matrix<T const> const &a, Matrix<T const> const &b, Matrix<T> const &c) {
+    for (std::size_t i = 0; i < c.rows; ++i) {
+        for (std::size_t j = 0; j < c.cols; ++j) {
+            c(i, j) = T{};
+        }
+        for (std::size_t p = 0; p < a.cols; ++p) {
+            auto x = a(i, p);
+            for (std::size_t j = 0; j < c.cols; ++j) {
+                c(i, j) += x * b(p, j);
+            }
+        }
+    }
+}
+
+// c = a b，`parallel` 为假时只在当前线程上计算
+template<class T>
+void gemm(Matrix<T const> const &a, Matrix<T const> const &b, Matrix<T> const &c, bool parallel) {
+    auto const M = c.rows, N = c.cols, K = a.cols;
+    if (M == 0 || N == 0) {
+        return;
+    }
+    if constexpr (!simd::supported<T>) {
+        gemm_naive(a, b, c);
+        return;
+    } else {
+        if (K == 0) {
+            gemm_naive(a, b, c);
+            return;
+        }
+        auto const &kernels = simd::kernels<T>(simd::active_isa());
+        auto const kernel = kernels.gemm;
+        auto const mr = kernels.gemm_mr, nr = kernels.gemm_nr;
+        ASSERT(mr * nr <= GEMM_MAX_TILE, "Register block " << mr << "x" << nr << " exceeds " << GEMM_MAX_TILE);
+        auto const kc_max = std::min<std::size_t>(std::max<std::size_t>(GEMM_L1 / (nr * sizeof(T)), 64), 512);
+        auto const mc_max = std::max<std::size_t>(GEMM_L2 / (kc_max * sizeof(T)) / mr, 1) * mr;
+        auto const nc_max = std::max<std::size_t>(GEMM_L3 / (kc_max * sizeof(T)) / nr, 1) * nr;
+        auto &pool = default_pool();
+        auto run = [&](std::size_t tasks, std::size_t grain, auto &&f) {
+            if (parallel) {
+                pool.parallel_for(0, tasks, grain, f);
+            } else {
+                f(0, tasks);
+            }
+        };
+
+        auto packed_b = Storage<T>::allocate(std::min(K, kc_max) * ((std::min(N, nc_max) + nr - 1) / nr * nr));
+        for (std::size_t jc = 0; jc < N; jc += nc_max) {
+            auto const nc = std::min(nc_max, N - jc);
+            auto const panels = (nc + nr - 1) / nr;
+            for (std::size_t pc = 0; pc < K; pc += kc_max) {
+                auto const kc = std::min(kc_max, K - pc);
+                auto const accumulate = pc > 0;
+                auto const pb = packed_b.get();
+                run(panels, std::max<std::size_t>(GEMM_GRAIN / (kc * nr), 1), [&](std::size_t begin, std::size_t end) {
+                    for (auto j = begin; j < end; ++j) {
+                        pack_b(b.block(pc, jc + j * nr, kc, std::min(nr, nc - j * nr)), nr, pb + j * kc * nr);
+                    }
+                });
+                // A 的行块不够分时再把 C 的列切成几段，使任务数不少于线程数的两倍
+                auto const row_blocks = (M + mc_max - 1) / mc_max;
+                auto const splits = parallel ? std::min(std::max<std::size_t>((2 * pool.limit() + row_blocks - 1) / row_blocks, 1), panels) : 1;
+                auto const work = std::min(M, mc_max) * kc * nc / splits;
+                run(row_blocks * splits, std::max<std::size_t>(GEMM_GRAIN / std::max<std::size_t>(work, 1), 1), [&](std::size_t begin, std::size_t end) {
+                    auto packed_a = Storage<T>::allocate(std::min(M, mc_max) / mr * mr * kc + mr * kc);
+                    auto const pa = packed_a.get();
+                    T tile[GEMM_MAX_TILE];
+                    for (auto task = begin; task < end; ++task) {
+                        auto const ic = task / splits * mc_max, split = task % splits;
+                        auto const mc = std::min(mc_max, M - ic);
+                        pack_a(a.block(ic, pc, mc, kc), mr, pa);
+                        for (auto j = panels * split / splits; j < panels * (split + 1) / splits; ++j) {
+                            auto const n = std::min(nr, nc - j * nr);
+                            for (std::size_t ir = 0; ir < mc; ir += mr) {
+                                auto const m = std::min(mr, mc - ir);
+                                auto const dst = &c(ic + ir, jc + j * nr);
+                                if (m == mr && n == nr && c.col_stride == 1) {
+                                    kernel(kc, pa + ir * kc, pb + j * kc * nr, dst, c.row_stride, accumulate);
+                                    continue;
+                                }
+                                // 边缘或列不连续：先写到临时缓冲，再按 C 的步长写回
+                                kernel(kc, pa + ir * kc, pb + j * kc * nr, tile, static_cast<std::ptrdiff_t>(nr), false);
+                                auto out = c.block(ic + ir, jc + j * nr, m, n);
+                                for (std::size_t i = 0; i < m; ++i) {
+                                    for (std::size_t jj = 0; jj < n; ++jj) {
+                                        out(i, jj) = accumulate ? out(i, jj) + tile[i * nr + jj] : tile[i * nr + jj];
+                                    }
+                                }
+                            }
+                        }
+                    }
+                });
+            }
+        }
+    }
+}
+
+// 视图中的第 `index` 个矩阵：二阶视图只有一个矩阵，三阶视图的批长度为 1 时广播到每个批
+template<class T>
+Matrix<T> matrix(TensorView<T> const &v, std::size_t index) {
+    auto const lead = v.rank - 2;
+    auto data = v.origin();
+    if (lead && v.shape[0] != 1) {
+        data += static_cast<std::ptrdiff_t>(index) * v.strides[0];
+    }
+    return {data, v.shape[lead], v.shape[lead + 1], v.strides[lead], v.strides[lead + 1]};
+}
+
+// c = a b。a 为 [M, K]、b 为 [K, N] 时 c 为 [M, N]；c 为三阶时第 0 维是批，
+// a、b 可以是二阶或批长度为 1 的三阶，广播到 c 的每个批。c 不能与 a、b 重叠
+template<class SA, class SB, class T>
+void matmul_into(TensorView<SA> const &a, TensorView<SB> const &b, TensorView<T> const &c) {
+    static_assert(std::is_same<std::remove_const_t<SA>, T>::value && std::is_same<std::remove_const_t<SB>, T>::value,
+                  "Operands must have the same element type");
+    ASSERT(c.rank == 2 || c.rank == 3, "Cannot multiply into a tensor of rank " << c.rank);
+    ASSERT(a.rank >= 2 && a.rank <= c.rank && b.rank >= 2 && b.rank <= c.rank,
+           "Cannot multiply tensors of rank " << a.rank << " and " << b.rank << " into rank " << c.rank);
+    auto const batch = c.rank == 3 ? c.shape[0] : 1;
+    ASSERT(a.rank == 2 || a.shape[0] == batch || a.shape[0] == 1, "Cannot broadcast a batch of " << a.shape[0] << " to " << batch);
+    ASSERT(b.rank == 2 || b.shape[0] == batch || b.shape[0] == 1, "Cannot broadcast a batch of " << b.shape[0] << " to " << batch);
+    if (batch == 0) {
+        return;
+    }
+    auto const a0 = matrix(TensorView<T const>(a), 0);
+    auto const b0 = matrix(TensorView<T const>(b), 0);
+    auto const c0 = matrix(c, 0);
+    ASSERT(a0.rows == c0.rows && b0.cols == c0.cols && a0.cols == b0.rows,
+           "Cannot multiply " << a0.rows << "x" << a0.cols << " by " << b0.rows << "x" << b0.cols << " into " << c0.rows << "x" << c0.cols);
+    auto item = [&](std::size_t i, bool parallel) {
+        gemm(matrix(TensorView<T const>(a), i), matrix(TensorView<T const>(b), i), matrix(c, i), parallel);
+    };
+    auto const work = std::max<std::size_t>(c0.rows * c0.cols * a0.cols, 1);
+    auto &pool = default_pool();
+    // 批足够多或每个矩阵都很小时按批切分，每个矩阵在一个线程上计算
+    if (batch > 1 && (batch >= pool.limit() || work < GEMM_GRAIN)) {
+        pool.parallel_for(0, batch, std::max<std::size_t>(GEMM_GRAIN / work, 1), [&](std::size_t begin, std::size_t end) {
+            for (auto i = begin; i < end; ++i) {
+                item(i, false);
+            }
+        });
+        return;
+    }
+    for (std::size_t i = 0; i < batch; ++i) {
+        item(i, true);
+    }
+}
+
+// c = a b，`a`、`b`、`c` 可以是视图（包括转置的视图），也可以是带有 `shape` 和 `data` 成员的连续张量
+// （如练习 23 中的 `Tensor<2, T>`、`Tensor<3, T>`）
+template<class A, class B, class C>
+auto matmul(A const &a, B const &b, C &&c) -> decltype(view(a), view(b), view(c), void()) {
+    matmul_into(view(a), view(b), view(c));
+}
+
+}// namespace tensor
+
+#endif// __TENSOR_MATMUL_H__
@@ -0,0 +1,222 @@
+﻿#ifndef __TENSOR_PARALLEL_H__
+#define __TENSOR_PARALLEL_H__
+
+// 张量核函数共用的线程池。
+// 工作按粒度切分：元素数不足两个粒度的运算直接在调用线程上执行，小张量不会触碰线程池；
+// 调用线程也参与计算，线程池内部再次发起的并行调用在当前线程上串行执行；
+// 任一段抛出的异常在所有参与者离开后于调用线程上重新抛出。
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace tensor {
+
+// 逐元素运算的默认粒度（元素数）：每个线程至少分到这么多元素才值得并行
+constexpr std::size_t GRAIN = 1 << 15;
+
+class ThreadPool {
+public:
+    // 共 `threads` 个线程参与计算，其中一个是调用线程
+    explicit ThreadPool(unsigned int threads) : limit_(std::max(threads, 1u)) {
+        for (auto i = 1u; i < threads; ++i) {
+            workers_.emplace_back([this] { work(); });
+        }
+    }
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        // 在工作线程上调用 `exit`（如核函数中的断言失败）时析构发生在该线程上，它不能等待自己
+        for (auto &worker : workers_) {
+            if (worker.get_id() == std::this_thread::get_id()) {
+                worker.detach();
+            } else {
+                worker.join();
+            }
+        }
+    }
+    ThreadPool(ThreadPool const &) = delete;
+    ThreadPool &operator=(ThreadPool const &) = delete;
+
+    unsigned int size() const {
+        return static_cast<unsigned int>(workers_.size()) + 1;
+    }
+
+    // 之后的并行调用最多使用的线程数，用于测量扩展性
+    void set_limit(unsigned int threads) {
+        limit_.store(std::min(std::max(threads, 1u), size()), std::memory_order_relaxed);
+    }
+    unsigned int limit() const {
+        return limit_.load(std::memory_order_relaxed);
+    }
+
+    // [begin, end) 按粒度 `grain` 切成至多 `limit()` 段，并行调用 `f(b, e)`
+    template<class F>
+    void parallel_for(std::size_t begin, std::size_t end, std::size_t grain, F &&f) {
+        auto const n = end > begin ? end - begin : 0;
+        auto const chunks = chunks_for(n, grain);
+        if (chunks <= 1) {
+            if (n) {
+                f(begin, end);
+            }
+            return;
+        }
+        auto body = [&](std::size_t i) {
+            f(begin + n * i / chunks, begin + n * (i + 1) / chunks);
+        };
+        run(chunks, body);
+    }
+
+    // 把 [begin, end) 切段后各段 `map(b, e)` 的结果按段的顺序用 `combine` 合并，结果与线程数无关
+    template<class R, class Map, class Combine>
+    R parallel_reduce(std::size_t begin, std::size_t end, std::size_t grain, R init, Map &&map, Combine &&combine) {
+        auto const n = end > begin ? end - begin : 0;
+        auto const chunks = chunks_for(n, grain);
+        if (chunks <= 1) {
+            return n ? combine(init, map(begin, end)) : init;
+        }
+        std::vector<R> partial(chunks, init);
+        auto body = [&](std::size_t i) {
+            partial[i] = map(begin + n * i / chunks, begin + n * (i + 1) / chunks);
+        };
+        run(chunks, body);
+        for (auto const &value : partial) {
+            init = combine(init, value);
+        }
+        return init;
+    }
+
+private:
+    // 标记当前线程正在执行线程池的任务，离开作用域（包括任务抛出异常）时恢复
+    class Inside {
+    public:
+        Inside() : previous_(inside_) {
+            inside_ = true;
+        }
+        ~Inside() {
+            inside_ = previous_;
+        }
+        Inside(Inside const &) = delete;
+        Inside &operator=(Inside const &) = delete;
+
+    private:
+        bool previous_;
+    };
+
+    std::size_t chunks_for(std::size_t n, std::size_t grain) const {
+        if (inside_) {
+            return 1;
+        }
+        grain = std::max<std::size_t>(grain, 1);
+        return std::min<std::size_t>(limit(), n / grain);
+    }
+
+    template<class F>
+    static void call(void *context, std::size_t i) {
+        (*static_cast<F *>(context))(i);
+    }
+
+    // 调用线程与工作线程一起领取并执行 `chunks` 段，全部完成后返回。
+    // 上一次的参与者全部离开后才布置新的任务，迟到的工作线程只会看到已经领完的旧任务
+    template<class F>
+    void run(std::size_t chunks, F &body) {
+        std::lock_guard<std::mutex> submit(submit_);
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            done_.wait(lock, [this] { return active_ == 0; });
+            call_ = &call<F>;
+            context_ = &body;
+            chunks_ = chunks;
+            next_.store(0, std::memory_order_relaxed);
+            ++generation_;
+        }
+        wake_.notify_all();
+        {
+            Inside inside;
+            take();
+        }
+        // 等工作线程都离开仍在栈上的 `body` 后，在调用线程上重新抛出任一段的异常
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return active_ == 0; });
+        if (auto error = std::exchange(error_, nullptr)) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    // 某段抛出异常时记下第一个异常，并放弃其余未领取的段
+    void take() {
+        for (std::size_t i; (i = next_.fetch_add(1, std::memory_order_relaxed)) < chunks_;) {
+            try {
+                call_(context_, i);
+            } catch (...) {
+                next_.store(chunks_, std::memory_order_relaxed);
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!error_) {
+                    error_ = std::current_exception();
+                }
+            }
+        }
+    }
+
+    void work() {
+        Inside inside;
+        std::size_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+            if (stop_) {
+                return;
+            }
+            seen = generation_;
+            ++active_;
+            lock.unlock();
+            take();
+            lock.lock();
+            if (--active_ == 0) {
+                done_.notify_all();
+            }
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::atomic<unsigned int> limit_;
+    std::mutex submit_, mutex_;
+    std::condition_variable wake_, done_;
+    bool stop_ = false;
+    std::size_t generation_ = 0, active_ = 0;
+    void (*call_)(void *, std::size_t) = nullptr;
+    void *context_ = nullptr;
+    std::size_t chunks_ = 0;
+    std::atomic<std::size_t> next_{0};
+    std::exception_ptr error_;
+    static inline thread_local bool inside_ = false;
+};
+
+// 核函数默认使用的线程池，线程数为硬件并发数，环境变量 TENSOR_THREADS 可以指定。
+// 有意不析构：进程退出时其他线程可能仍在等待或执行它的任务
+inline ThreadPool &default_pool() {
+    static auto &pool = *new ThreadPool([] {
+        if (auto env = std::getenv("TENSOR_THREADS")) {
+            auto threads = std::atoi(env);
+            if (threads > 0) {
+                return static_cast<unsigned int>(threads);
+            }
+        }
+        return std::max(std::thread::hardware_concurrency(), 1u);
+    }());
+    return pool;
+}
+
+}// namespace tensor
+
+#endif// __TENSOR_PARALLEL_H__
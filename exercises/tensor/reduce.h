@@ -0,0 +1,488 @@
+﻿#ifndef __TENSOR_REDUCE_H__
+#define __TENSOR_REDUCE_H__
+
+// 沿任意一组轴的归约：求和、平均、最大值、最小值和最大值的下标。
+// 输出与输入同阶，被归约的轴在输出中长度为 1，其余轴与输入相同；不给输出时归约全部元素并直接返回结果。
+// 各维先按输入步长重排、合并（见 broadcast.h），再按最内层是否被归约分两种做法：
+// 被归约时每个输出元素归约一段行，行内由 SIMD 核函数按块成对求和，多行的结果再成对合并；
+// 保留时把输入逐行累加到一块输出上（按列分块），累加器同样成对合并，使 float 求和的误差随长度对数增长。
+// 输出足够多时按输出切分给线程池，否则把被归约的元素切段并行归约后按段的顺序合并。
+
+#include "view.h"
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace tensor {
+
+// 两个部分结果的合并；含 NaN 时最大、最小值未定义
+template<simd::Reduce op, class T>
+T reduce_combine(T a, T b) {
+    switch (op) {
+        case simd::Reduce::Sum:
+            return a + b;
+        case simd::Reduce::Max:
+            return a > b ? a : b;
+        default:
+            return a < b ? a : b;
+    }
+}
+
+// 没有 SIMD 核函数或步长不为 1 时，一行中顺序累加的最大元素数，更长的行对半拆分后成对合并
+constexpr std::size_t PAIRWISE_BLOCK = 128;
+
+// 一行 `n`（不为 0）个元素的归约，步长以元素计
+template<simd::Reduce op, class T>
+T reduce_row(T const *p, std::size_t n, std::ptrdiff_t stride) {
+    if constexpr (simd::supported<T>) {
+        if (stride == 1) {
+            return simd::reduce(op, p, n);
+        }
+    }
+    if (n > PAIRWISE_BLOCK) {
+        auto half = n / 2;
+        return reduce_combine<op>(reduce_row<op>(p, half, stride),
+                                  reduce_row<op>(p + static_cast<std::ptrdiff_t>(half) * stride, n - half, stride));
+    }
+    auto ans = *p;
+    for (std::size_t i = 1; i < n; ++i) {
+        ans = reduce_combine<op>(ans, p[static_cast<std::ptrdiff_t>(i) * stride]);
+    }
+    return ans;
+}
+
+// dst[i] = dst[i] op row[i * stride]
+template<simd::Reduce op, class T>
+void reduce_accumulate(T *dst, T const *row, std::ptrdiff_t stride, std::size_t n) {
+    if constexpr (simd::supported<T>) {
+        if (stride == 1) {
+            simd::accumulate(op, dst, row, n);
+            return;
+        }
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+        dst[i] = reduce_combine<op>(dst[i], row[static_cast<std::ptrdiff_t>(i) * stride]);
+    }
+}
+
+// 按二进制进位成对合并的累加器：每个叶子顺序累加至多 `leaf` 行宽 `width` 的输入，
+// 第 k 级保存 2^k 个叶子的部分结果，新叶子与同级的部分结果合并后向上进位，合并顺序与成对求和的二叉树相同
+template<simd::Reduce op, class T>
+class Cascade {
+public:
+    Cascade(std::size_t width, std::size_t leaf) : width_(width), leaf_(leaf) {}
+
+    // 清空并改用宽度 `width`
+    void reset(std::size_t width) {
+        width_ = width;
+        count_ = rows_ = 0;
+    }
+
+    void add(T const *row, std::ptrdiff_t stride) {
+        auto leaf = slot(0);
+        if (rows_ == 0) {
+            for (std::size_t i = 0; i < width_; ++i) {
+                leaf[i] = row[static_cast<std::ptrdiff_t>(i) * stride];
+            }
+        } else {
+            reduce_accumulate<op>(leaf, row, stride, width_);
+        }
+        if (++rows_ == leaf_) {
+            push();
+        }
+    }
+
+    // 合并全部部分结果写到步长为 `stride` 的 `out`，之后重新开始累加；至少加过一行
+    void finish(T *out, std::ptrdiff_t stride) {
+        if (rows_ > 0) {
+            push();
+        }
+        // 高位的部分结果来自靠前的行，先合并
+        T *ans = nullptr;
+        for (auto k = levels_; k-- > 0;) {
+            if (count_ >> k & 1) {
+                if (ans) {
+                    reduce_accumulate<op>(ans, slot(k + 1), 1, width_);
+                } else {
+                    ans = slot(k + 1);
+                }
+            }
+        }
+        for (std::size_t i = 0; i < width_; ++i) {
+            out[static_cast<std::ptrdiff_t>(i) * stride] = ans[i];
+        }
+        count_ = rows_ = 0;
+    }
+
+private:
+    // 第 0 格是正在累加的叶子，第 k + 1 格是第 k 级
+    T *slot(unsigned int i) {
+        if (buffer_.size() < (i + 1) * width_) {
+            buffer_.resize((i + 1) * width_);
+        }
+        return buffer_.data() + i * width_;
+    }
+
+    void push() {
+        // 先按可能用到的最高一级分配好缓冲，之后取得的指针不会失效
+        slot(levels_ + 1);
+        unsigned int k = 0;
+        auto carry = slot(0);
+        for (; count_ >> k & 1; ++k) {
+            reduce_accumulate<op>(slot(k + 1), carry, 1, width_);
+            carry = slot(k + 1);
+        }
+        auto top = slot(k + 1);
+        if (carry != top) {
+            std::copy(carry, carry + width_, top);
+        }
+        levels_ = std::max(levels_, k + 1);
+        ++count_;
+        rows_ = 0;
+    }
+
+    std::vector<T> buffer_;
+    std::size_t width_, leaf_;
+    std::size_t count_ = 0, rows_ = 0;
+    unsigned int levels_ = 0;
+};
+
+// 行主序中第 `index` 个位置上各操作数相对起点的偏移
+template<std::size_t K>
+std::array<std::ptrdiff_t, K> offsets(Loop<K> const &loop, std::size_t index) {
+    std::array<std::ptrdiff_t, K> ans{};
+    for (auto d = loop.rank; d-- > 0;) {
+        auto i = static_cast<std::ptrdiff_t>(index % loop.extents[d]);
+        index /= loop.extents[d];
+        for (auto k = 0u; k < K; ++k) {
+            ans[k] += loop.strides[k][d] * i;
+        }
+    }
+    return ans;
+}
+
+// 把各维分成保留的和被归约的两组。输出与输入同阶，`out` 中长度为 1 而 `in` 中不为 1 的轴被归约，
+// 其余轴长度必须相同；被归约的轴在输出上的步长记为 0
+template<class T, class Out>
+void reduce_strides(TensorView<T> const &in, TensorView<Out> const &out, std::size_t *extents, std::ptrdiff_t (&strides)[2][MAX_RANK]) {
+    ASSERT(in.rank == out.rank, "Cannot reduce a tensor of rank " << in.rank << " to rank " << out.rank);
+    for (auto d = 0u; d < in.rank; ++d) {
+        auto reduced = out.shape[d] == 1 && in.shape[d] != 1;
+        ASSERT(reduced || out.shape[d] == in.shape[d], "Cannot reduce axis " << d << " of length " << in.shape[d] << " to " << out.shape[d]);
+        ASSERT(reduced || out.strides[d] != 0 || in.shape[d] <= 1, "Output axis " << d << " must not be broadcast");
+        extents[d] = in.shape[d];
+        strides[0][d] = in.strides[d];
+        strides[1][d] = reduced ? 0 : out.strides[d];
+    }
+}
+
+// 按各维在输出上的步长是否为 0 分成保留的 `kept`（输入、输出）和被归约的 `sub`（输入）两个循环，
+// 各自保持原来的先后顺序；返回最内层的非平凡维是否被保留
+inline bool split_axes(unsigned int rank, std::size_t const *extents, std::ptrdiff_t const (&strides)[2][MAX_RANK],
+                       Loop<2> &kept, Loop<1> &sub) {
+    std::size_t kept_extents[MAX_RANK]{}, sub_extents[MAX_RANK]{};
+    std::ptrdiff_t kept_strides[2][MAX_RANK]{}, sub_strides[MAX_RANK]{};
+    auto kept_rank = 0u, sub_rank = 0u;
+    auto inner_kept = false;
+    for (auto d = 0u; d < rank; ++d) {
+        if (extents[d] == 1) {
+            continue;
+        }
+        inner_kept = strides[1][d] != 0;
+        if (inner_kept) {
+            kept_extents[kept_rank] = extents[d];
+            kept_strides[0][kept_rank] = strides[0][d];
+            kept_strides[1][kept_rank++] = strides[1][d];
+        } else {
+            sub_extents[sub_rank] = extents[d];
+            sub_strides[sub_rank++] = strides[0][d];
+        }
+    }
+    kept = make_loop<2>(kept_rank, kept_extents, {kept_strides[0], kept_strides[1]});
+    sub = make_loop<1>(sub_rank, sub_extents, {sub_strides});
+    return inner_kept && sub_rank > 0;
+}
+
+// 输入逐行累加到输出时一块的列数
+constexpr std::size_t REDUCE_TILE = 1024;
+// 求和时一个叶子顺序累加的行数
+constexpr std::size_t REDUCE_LEAF = 8;
+
+// 沿 `out` 中长度为 1 的轴把 `in` 归约到 `out`
+template<simd::Reduce op, class S, class T>
+void reduce_into(TensorView<S> const &in, TensorView<T> const &out) {
+    static_assert(std::is_same<std::remove_const_t<S>, T>::value, "Operands must have the same element type");
+    std::size_t extents[MAX_RANK];
+    std::ptrdiff_t strides[2][MAX_RANK];
+    reduce_strides(in, out, extents, strides);
+    std::array<T *, 2> ptrs{const_cast<T *>(in.origin()), out.origin()};
+    // 被归约的各维与遍历顺序无关，输入上步长为负的维度可以翻转
+    normalize_axes(in.rank, extents, strides, ptrs);
+    Loop<2> kept;
+    Loop<1> sub;
+    auto vertical = split_axes(in.rank, extents, strides, kept, sub);
+    auto const outputs = kept.size(), count = sub.size();
+    if (outputs == 0) {
+        return;
+    }
+    if (count == 0) {
+        ASSERT(op == simd::Reduce::Sum, "Cannot take the maximum or minimum of an empty tensor");
+        for_each_row(kept, ptrs, [](auto const &p, std::size_t n, auto const &s) {
+            for (std::size_t i = 0; i < n; ++i) {
+                p[1][static_cast<std::ptrdiff_t>(i) * s[1]] = T{};
+            }
+        });
+        return;
+    }
+    auto &pool = default_pool();
+    auto const many = outputs >= 2 * pool.limit() || outputs * count < 2 * GRAIN;
+    auto const leaf = op == simd::Reduce::Sum ? REDUCE_LEAF : count;
+
+    if (!vertical) {
+        // 每个输出元素归约输入中以 `p` 为起点的一块里的第 [begin, end) 个元素
+        auto range = [&sub](T const *p, std::size_t begin, std::size_t end, Cascade<op, T> &cascade) {
+            if (sub.rank == 1) {
+                auto stride = sub.strides[0][0];
+                return reduce_row<op>(p + static_cast<std::ptrdiff_t>(begin) * stride, end - begin, stride);
+            }
+            for_each_row(sub, std::array<T const *, 1>{p}, [&cascade](auto const &q, std::size_t n, auto const &s) {
+                auto value = reduce_row<op>(q[0], n, s[0]);
+                cascade.add(&value, 1);
+            }, begin, end);
+            T ans;
+            cascade.finish(&ans, 1);
+            return ans;
+        };
+        if (many) {
+            parallel_for_each_row(kept, ptrs, [&](auto const &p, std::size_t n, auto const &s) {
+                Cascade<op, T> cascade(1, 1);
+                for (std::size_t i = 0; i < n; ++i) {
+                    p[1][static_cast<std::ptrdiff_t>(i) * s[1]] = range(p[0] + static_cast<std::ptrdiff_t>(i) * s[0], 0, count, cascade);
+                }
+            }, std::max<std::size_t>(GRAIN / count, 1));
+            return;
+        }
+        for_each_row(kept, ptrs, [&](auto const &p, std::size_t n, auto const &s) {
+            for (std::size_t i = 0; i < n; ++i) {
+                T const *base = p[0] + static_cast<std::ptrdiff_t>(i) * s[0];
+                // 求和从 0 开始；最大、最小值与自身合并不变，以第一个元素为初值
+                auto init = op == simd::Reduce::Sum ? T{} : *base;
+                p[1][static_cast<std::ptrdiff_t>(i) * s[1]] = pool.parallel_reduce(
+                        0, count, GRAIN, init,
+                        [&](std::size_t begin, std::size_t end) {
+                            Cascade<op, T> cascade(1, 1);
+                            return range(base, begin, end, cascade);
+                        },
+                        reduce_combine<op, T>);
+            }
+        });
+        return;
+    }
+
+    // 最内层保留：以输入中连续的一行为单位，按列分块累加到输出
+    auto const inner = kept.rank - 1;
+    auto const width = kept.extents[inner];
+    auto const in_stride = kept.strides[0][inner], out_stride = kept.strides[1][inner];
+    auto rows = kept;
+    if (rows.rank == 1) {
+        rows.extents[0] = 1;
+    } else {
+        rows.rank -= 1;
+    }
+    auto const tiles = (width + REDUCE_TILE - 1) / REDUCE_TILE;
+    // 第 `task` 块（外层位置与列块）的输入、输出起点和列数
+    auto locate = [&](std::size_t task) {
+        auto offset = offsets(rows, task / tiles);
+        auto column = static_cast<std::ptrdiff_t>(task % tiles * REDUCE_TILE);
+        return std::make_tuple(ptrs[0] + offset[0] + column * in_stride, ptrs[1] + offset[1] + column * out_stride,
+                               std::min(REDUCE_TILE, width - static_cast<std::size_t>(column)));
+    };
+    auto range = [&sub, in_stride](T const *p, std::size_t begin, std::size_t end, Cascade<op, T> &cascade) {
+        for_each_row(sub, std::array<T const *, 1>{p}, [&](auto const &q, std::size_t n, auto const &s) {
+            for (std::size_t i = 0; i < n; ++i) {
+                cascade.add(q[0] + static_cast<std::ptrdiff_t>(i) * s[0], in_stride);
+            }
+        }, begin, end);
+    };
+    auto const tasks = rows.size() * tiles;
+    if (tasks >= 2 * pool.limit() || outputs * count < 2 * GRAIN) {
+        pool.parallel_for(0, tasks, std::max<std::size_t>(GRAIN / (count * REDUCE_TILE), 1), [&](std::size_t begin, std::size_t end) {
+            Cascade<op, T> cascade(REDUCE_TILE, leaf);
+            for (auto task = begin; task < end; ++task) {
+                auto [src, dst, n] = locate(task);
+                cascade.reset(n);
+                range(src, 0, count, cascade);
+                cascade.finish(dst, out_stride);
+            }
+        });
+        return;
+    }
+    for (std::size_t task = 0; task < tasks; ++task) {
+        auto [src, dst, n] = locate(task);
+        auto ans = pool.parallel_reduce(
+                0, count, std::max<std::size_t>(GRAIN / n, 1), std::vector<T>{},
+                [&, src = src, n = n](std::size_t begin, std::size_t end) {
+                    Cascade<op, T> cascade(n, leaf);
+                    range(src, begin, end, cascade);
+                    std::vector<T> partial(n);
+                    cascade.finish(partial.data(), 1);
+                    return partial;
+                },
+                [](std::vector<T> a, std::vector<T> const &b) {
+                    if (a.empty()) {
+                        return b;
+                    }
+                    reduce_accumulate<op>(a.data(), b.data(), 1, a.size());
+                    return a;
+                });
+        for (std::size_t i = 0; i < n; ++i) {
+            dst[static_cast<std::ptrdiff_t>(i) * out_stride] = ans[i];
+        }
+    }
+}
+
+// 沿 `out` 中长度为 1 的轴求 `in` 中最大值的下标，即其在被归约的各轴上按行主序的序号（只归约一个轴时就是该轴上的下标），
+// 最大值有多个时取第一个。下标的含义依赖轴的顺序，不重排也不翻转各维
+template<class S>
+void argmax_into(TensorView<S> const &in, TensorView<std::size_t> const &out) {
+    using T = std::remove_const_t<S>;
+    std::size_t extents[MAX_RANK];
+    std::ptrdiff_t strides[2][MAX_RANK];
+    reduce_strides(in, out, extents, strides);
+    Loop<2> kept;
+    Loop<1> sub;
+    split_axes(in.rank, extents, strides, kept, sub);
+    auto const outputs = kept.size(), count = sub.size();
+    if (outputs == 0) {
+        return;
+    }
+    ASSERT(count > 0, "Cannot take the argmax of an empty tensor");
+    using Best = std::pair<T, std::size_t>;
+    static constexpr auto NONE = ~std::size_t{0};
+    // 输入中以 `p` 为起点的一块里第 [begin, end) 个元素中的最大值及其序号
+    auto range = [&sub](T const *p, std::size_t begin, std::size_t end) {
+        Best best{T{}, NONE};
+        auto position = begin;
+        for_each_row(sub, std::array<T const *, 1>{p}, [&](auto const &q, std::size_t n, auto const &s) {
+            std::size_t i = 0;
+            if constexpr (simd::supported<T>) {
+                if (s[0] == 1) {
+                    i = simd::argmax(q[0], n);
+                }
+            }
+            if (s[0] != 1 || !simd::supported<T>) {
+                for (std::size_t j = 1; j < n; ++j) {
+                    if (q[0][static_cast<std::ptrdiff_t>(j) * s[0]] > q[0][static_cast<std::ptrdiff_t>(i) * s[0]]) {
+                        i = j;
+                    }
+                }
+            }
+            auto value = q[0][static_cast<std::ptrdiff_t>(i) * s[0]];
+            if (best.second == NONE || value > best.first) {
+                best = {value, position + i};
+            }
+            position += n;
+        }, begin, end);
+        return best;
+    };
+    auto const in_origin = in.origin();
+    auto const out_origin = out.origin();
+    auto &pool = default_pool();
+    if (outputs >= 2 * pool.limit() || outputs * count < 2 * GRAIN) {
+        pool.parallel_for(0, outputs, std::max<std::size_t>(GRAIN / count, 1), [&](std::size_t begin, std::size_t end) {
+            for (auto i = begin; i < end; ++i) {
+                auto offset = offsets(kept, i);
+                out_origin[offset[1]] = range(in_origin + offset[0], 0, count).second;
+            }
+        });
+        return;
+    }
+    for (std::size_t i = 0; i < outputs; ++i) {
+        auto offset = offsets(kept, i);
+        auto best = pool.parallel_reduce(
+                0, count, GRAIN, Best{T{}, NONE},
+                [&](std::size_t begin, std::size_t end) { return range(in_origin + offset[0], begin, end); },
+                [](Best const &a, Best const &b) { return a.second == NONE || b.first > a.first ? b : a; });
+        out_origin[offset[1]] = best.second;
+    }
+}
+
+// 全部元素归约成一个值：输出为同阶、各轴长度都为 1 的视图
+template<simd::Reduce op, class S>
+std::remove_const_t<S> reduce_all(TensorView<S> const &in) {
+    std::size_t ones[MAX_RANK];
+    std::fill(ones, ones + in.rank, std::size_t{1});
+    std::remove_const_t<S> ans{};
+    reduce_into<op>(in, TensorView<std::remove_const_t<S>>(&ans, in.rank, ones));
+    return ans;
+}
+
+// 以下各函数的 `in`、`out` 可以是视图，也可以是带有 `shape` 和 `data` 成员的连续张量（如练习 23 中的 `Tensor<N, T>`）。
+// 给出 `out` 时沿其中长度为 1 的轴归约，否则归约全部元素并返回结果
+
+template<class In, class Out>
+auto sum(In const &in, Out &&out) -> decltype(view(in), view(out), void()) {
+    reduce_into<simd::Reduce::Sum>(view(in), view(out));
+}
+template<class In>
+auto sum(In const &in) -> decltype(reduce_all<simd::Reduce::Sum>(view(in))) {
+    return reduce_all<simd::Reduce::Sum>(view(in));
+}
+
+// 平均值，整数按整数除法
+template<class In, class Out>
+auto mean(In const &in, Out &&out) -> decltype(view(in), view(out), void()) {
+    auto src = view(in);
+    auto dst = view(out);
+    reduce_into<simd::Reduce::Sum>(src, dst);
+    if (auto const outputs = dst.size()) {
+        auto const count = src.size() / outputs;
+        ASSERT(count > 0, "Cannot take the mean of an empty tensor");
+        auto const divisor = static_cast<typename decltype(dst)::value_type>(count);
+        broadcast_inplace(dst, TensorView<decltype(divisor)>(&divisor, 0, dst.shape), Div{});
+    }
+}
+template<class In>
+auto mean(In const &in) -> decltype(reduce_all<simd::Reduce::Sum>(view(in))) {
+    auto src = view(in);
+    auto const count = src.size();
+    ASSERT(count > 0, "Cannot take the mean of an empty tensor");
+    return reduce_all<simd::Reduce::Sum>(src) / static_cast<decltype(reduce_all<simd::Reduce::Sum>(src))>(count);
+}
+
+template<class In, class Out>
+auto max(In const &in, Out &&out) -> decltype(view(in), view(out), void()) {
+    reduce_into<simd::Reduce::Max>(view(in), view(out));
+}
+template<class In>
+auto max(In const &in) -> decltype(reduce_all<simd::Reduce::Max>(view(in))) {
+    return reduce_all<simd::Reduce::Max>(view(in));
+}
+
+template<class In, class Out>
+auto min(In const &in, Out &&out) -> decltype(view(in), view(out), void()) {
+    reduce_into<simd::Reduce::Min>(view(in), view(out));
+}
+template<class In>
+auto min(In const &in) -> decltype(reduce_all<simd::Reduce::Min>(view(in))) {
+    return reduce_all<simd::Reduce::Min>(view(in));
+}
+
+// `out` 的元素类型为 std::size_t；不给 `out` 时返回全部元素中第一个最大值按行主序的序号
+template<class In, class Out>
+auto argmax(In const &in, Out &&out) -> decltype(view(in), view(out), void()) {
+    argmax_into(view(in), view(out));
+}
+template<class In>
+auto argmax(In const &in) -> decltype(view(in), std::size_t()) {
+    auto src = view(in);
+    std::size_t ones[MAX_RANK];
+    std::fill(ones, ones + src.rank, std::size_t{1});
+    std::size_t ans = 0;
+    argmax_into(src, TensorView<std::size_t>(&ans, src.rank, ones));
+    return ans;
+}
+
+}// namespace tensor
+
+#endif// __TENSOR_REDUCE_H__
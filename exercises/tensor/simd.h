@@ -0,0 +1,489 @@
+﻿#ifndef __TENSOR_SIMD_H__
+#define __TENSOR_SIMD_H__
+
+// 逐元素运算、归约和矩阵乘的 SIMD 核函数及运行时指令集分派。
+// 同一份核函数（simd_kernels.h）在 scalar、sse2、avx2、avx512 命名空间中各包含一次，
+// 除 scalar 外都以对应的目标指令集编译，所以不需要给整个程序加 -mavx2 之类的编译选项；
+// 运行时按 CPUID 选出处理器和操作系统都支持的最高指令集，环境变量 TENSOR_ISA 可以把它调低。
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define TENSOR_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#else
+#define TENSOR_X86 0
+#endif
+
+// 给其间定义的所有函数加上目标指令集；MSVC 不需要，内建函数总是可用
+#define TENSOR_PRAGMA(x) _Pragma(#x)
+#if defined(__clang__)
+#define TENSOR_TARGET_PUSH(isa) TENSOR_PRAGMA(clang attribute push(__attribute__((target(isa))), apply_to = function))
+#define TENSOR_TARGET_POP() TENSOR_PRAGMA(clang attribute pop)
+#elif defined(__GNUC__)
+#define TENSOR_TARGET_PUSH(isa) TENSOR_PRAGMA(GCC push_options) TENSOR_PRAGMA(GCC target(isa))
+#define TENSOR_TARGET_POP() TENSOR_PRAGMA(GCC pop_options)
+#else
+#define TENSOR_TARGET_PUSH(isa)
+#define TENSOR_TARGET_POP()
+#endif
+
+namespace tensor {
+namespace simd {
+
+enum class Isa {
+    Scalar,
+    SSE2,
+    AVX2,
+    AVX512,
+};
+constexpr int ISA_COUNT = 4;
+
+inline char const *isa_name(Isa isa) {
+    switch (isa) {
+        case Isa::SSE2:
+            return "sse2";
+        case Isa::AVX2:
+            return "avx2";
+        case Isa::AVX512:
+            return "avx512";
+        default:
+            return "scalar";
+    }
+}
+
+enum class Op {
+    Add,
+    Sub,
+    Mul,
+    Div,
+};
+constexpr int OP_COUNT = 4;
+
+// 归约运算
+enum class Reduce {
+    Sum,
+    Max,
+    Min,
+};
+constexpr int REDUCE_COUNT = 3;
+
+// 处理器和操作系统都支持的最高指令集。
+// AVX2 级别同时要求 FMA，AVX-512 级别只要求 AVX-512F；操作系统须通过 XCR0 声明保存了相应的寄存器状态
+inline Isa detect_isa() {
+#if TENSOR_X86
+    unsigned int regs[4]{};
+    auto cpuid = [&regs](unsigned int leaf) {
+#if defined(_MSC_VER)
+        int r[4];
+        __cpuidex(r, static_cast<int>(leaf), 0);
+        std::memcpy(regs, r, sizeof(regs));
+        return true;
+#else
+        return __get_cpuid_count(leaf, 0, &regs[0], &regs[1], &regs[2], &regs[3]) != 0;
+#endif
+    };
+    if (!cpuid(1) || !(regs[3] & (1u << 26))) {
+        return Isa::Scalar;
+    }
+    auto osxsave = (regs[2] & (1u << 27)) != 0, avx = (regs[2] & (1u << 28)) != 0, fma = (regs[2] & (1u << 12)) != 0;
+    if (!osxsave || !avx || !fma) {
+        return Isa::SSE2;
+    }
+#if defined(_MSC_VER)
+    auto xcr0 = static_cast<unsigned long long>(_xgetbv(0));
+#else
+    unsigned int lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    auto xcr0 = (static_cast<unsigned long long>(hi) << 32) | lo;
+#endif
+    // XMM、YMM 状态；AVX-512 另需 opmask、ZMM 高半部分和高 16 个 ZMM 寄存器的状态
+    if ((xcr0 & 0x6) != 0x6 || !cpuid(7) || !(regs[1] & (1u << 5))) {
+        return Isa::SSE2;
+    }
+    if ((xcr0 & 0xe0) != 0xe0 || !(regs[1] & (1u << 16))) {
+        return Isa::AVX2;
+    }
+    return Isa::AVX512;
+#else
+    return Isa::Scalar;
+#endif
+}
+
+// 当前使用的指令集：默认为 `detect_isa()`，环境变量 TENSOR_ISA（scalar、sse2、avx2、avx512）可以将其调低
+inline Isa &active_isa_storage() {
+    static Isa isa = [] {
+        auto ans = detect_isa();
+        if (auto env = std::getenv("TENSOR_ISA")) {
+            for (auto i = 0; i < ISA_COUNT; ++i) {
+                auto isa = static_cast<Isa>(i);
+                if (std::strcmp(env, isa_name(isa)) == 0 && isa < ans) {
+                    ans = isa;
+                }
+            }
+        }
+        return ans;
+    }();
+    return isa;
+}
+
+inline Isa active_isa() {
+    return active_isa_storage();
+}
+
+// 设置当前使用的指令集，不会超过 `detect_isa()`，返回实际生效的指令集
+inline Isa set_isa(Isa isa) {
+    auto max = detect_isa();
+    return active_isa_storage() = isa < max ? isa : max;
+}
+
+// 支持的元素类型
+template<class T>
+constexpr bool supported = false;
+template<>
+constexpr bool supported<float> = true;
+template<>
+constexpr bool supported<double> = true;
+template<>
+constexpr bool supported<int> = true;
+
+// 一个指令集上 `T` 类型的全部核函数，按 `Op` 编号索引：
+// binary:         dst[i] = a[i] op b[i]
+// binary_scalar:  dst[i] = a[i] op s
+// binary_rows:    dst[r * cols + j] = a[r * cols + j] op row[j]，一行向量广播到 `rows` 行
+// fma:            dst[i] = a[i] * b[i] + c[i]
+// fma_scalar:     dst[i] = a[i] * s + c[i]
+// reduce:         a[0] op a[1] op ... op a[n - 1]，按 `Reduce` 编号索引，n 不能为 0；求和按块成对累加
+// accumulate:     dst[i] = dst[i] op a[i]，按 `Reduce` 编号索引
+// argmax:         第一个最大值的下标，n 不能为 0
+// gemm:           c[i * ldc + j] (+)= sum_p a[p * mr + i] * b[p * nr + j]，i < gemm_mr，j < gemm_nr，
+//                 a、b 是按 mr 行、nr 列打包好的 k 步面板，accumulate 为假时覆盖 c
+// dst 可以与 a 相同。FMA 在 scalar 和 sse2 上是先乘后加，舍入可能与融合乘加不同；含 NaN 时最大、最小值未定义
+template<class T>
+struct Kernels {
+    void (*binary[OP_COUNT])(T *dst, T const *a, T const *b, std::size_t n);
+    void (*binary_scalar[OP_COUNT])(T *dst, T const *a, T s, std::size_t n);
+    void (*binary_rows[OP_COUNT])(T *dst, T const *a, T const *row, std::size_t rows, std::size_t cols);
+    void (*fma)(T *dst, T const *a, T const *b, T const *c, std::size_t n);
+    void (*fma_scalar)(T *dst, T const *a, T s, T const *c, std::size_t n);
+    T (*reduce[REDUCE_COUNT])(T const *a, std::size_t n);
+    void (*accumulate[REDUCE_COUNT])(T *dst, T const *a, std::size_t n);
+    std::size_t (*argmax)(T const *a, std::size_t n);
+    void (*gemm)(std::size_t k, T const *a, T const *b, T *c, std::ptrdiff_t ldc, bool accumulate);
+    std::size_t gemm_mr, gemm_nr;
+};
+
+// 标量“向量”：宽度为 1，供没有 SIMD 的平台和对照测量使用
+namespace scalar {
+
+template<class T>
+struct Vec {
+    using V = T;
+    static constexpr std::size_t width = 1;
+    static constexpr bool has_mul = true, has_div = true;
+    static V load(T const *p) { return *p; }
+    static void store(T *p, V v) { *p = v; }
+    static V set1(T x) { return x; }
+    static V add(V a, V b) { return a + b; }
+    static V sub(V a, V b) { return a - b; }
+    static V mul(V a, V b) { return a * b; }
+    static V div(V a, V b) { return a / b; }
+    static V fma(V a, V b, V c) { return a * b + c; }
+    static V max(V a, V b) { return a > b ? a : b; }
+    static V min(V a, V b) { return a < b ? a : b; }
+};
+
+#include "simd_kernels.h"
+
+}// namespace scalar
+
+#if TENSOR_X86
+
+TENSOR_TARGET_PUSH("sse2")
+namespace sse2 {
+
+template<class T>
+struct Vec;
+
+template<>
+struct Vec<float> {
+    using V = __m128;
+    static constexpr std::size_t width = 4;
+    static constexpr bool has_mul = true, has_div = true;
+    static V load(float const *p) { return _mm_loadu_ps(p); }
+    static void store(float *p, V v) { _mm_storeu_ps(p, v); }
+    static V set1(float x) { return _mm_set1_ps(x); }
+    static V add(V a, V b) { return _mm_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+    static V div(V a, V b) { return _mm_div_ps(a, b); }
+    static V fma(V a, V b, V c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    static V max(V a, V b) { return _mm_max_ps(a, b); }
+    static V min(V a, V b) { return _mm_min_ps(a, b); }
+};
+
+template<>
+struct Vec<double> {
+    using V = __m128d;
+    static constexpr std::size_t width = 2;
+    static constexpr bool has_mul = true, has_div = true;
+    static V load(double const *p) { return _mm_loadu_pd(p); }
+    static void store(double *p, V v) { _mm_storeu_pd(p, v); }
+    static V set1(double x) { return _mm_set1_pd(x); }
+    static V add(V a, V b) { return _mm_add_pd(a, b); }
+    static V sub(V a, V b) { return _mm_sub_pd(a, b); }
+    static V mul(V a, V b) { return _mm_mul_pd(a, b); }
+    static V div(V a, V b) { return _mm_div_pd(a, b); }
+    static V fma(V a, V b, V c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+    static V max(V a, V b) { return _mm_max_pd(a, b); }
+    static V min(V a, V b) { return _mm_min_pd(a, b); }
+};
+
+template<>
+struct Vec<int> {
+    using V = __m128i;
+    static constexpr std::size_t width = 4;
+    // SSE2 没有 32 位整数的低位乘法（SSE4.1 才有），用两次 32x32->64 位乘法拼出；整数除法没有 SIMD 指令
+    static constexpr bool has_mul = true, has_div = false;
+    static V load(int const *p) { return _mm_loadu_si128(reinterpret_cast<__m128i const *>(p)); }
+    static void store(int *p, V v) { _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v); }
+    static V set1(int x) { return _mm_set1_epi32(x); }
+    static V add(V a, V b) { return _mm_add_epi32(a, b); }
+    static V sub(V a, V b) { return _mm_sub_epi32(a, b); }
+    static V mul(V a, V b) {
+        auto even = _mm_mul_epu32(a, b);
+        auto odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+        return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                  _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    }
+    static V fma(V a, V b, V c) { return add(mul(a, b), c); }
+    // 有符号 32 位整数的最大、最小值同样要到 SSE4.1 才有，用比较结果做掩码选择
+    static V max(V a, V b) { return select(_mm_cmpgt_epi32(a, b), a, b); }
+    static V min(V a, V b) { return select(_mm_cmpgt_epi32(a, b), b, a); }
+    static V select(V mask, V a, V b) { return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); }
+};
+
+#include "simd_kernels.h"
+
+}// namespace sse2
+TENSOR_TARGET_POP()
+
+TENSOR_TARGET_PUSH("avx2,fma")
+namespace avx2 {
+
+template<class T>
+struct Vec;
+
+template<>
+struct Vec<float> {
+    using V = __m256;
+    static constexpr std::size_t width = 8;
+    static constexpr bool has_mul = true, has_div = true;
+    static V load(float const *p) { return _mm256_loadu_ps(p); }
+    static void store(float *p, V v) { _mm256_storeu_ps(p, v); }
+    static V set1(float x) { return _mm256_set1_ps(x); }
+    static V add(V a, V b) { return _mm256_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    static V div(V a, V b) { return _mm256_div_ps(a, b); }
+    static V fma(V a, V b, V c) { return _mm256_fmadd_ps(a, b, c); }
+    static V max(V a, V b) { return _mm256_max_ps(a, b); }
+    static V min(V a, V b) { return _mm256_min_ps(a, b); }
+};
+
+template<>
+struct Vec<double> {
+    using V = __m256d;
+    static constexpr std::size_t width = 4;
+    static constexpr bool has_mul = true, has_div = true;
+    static V load(double const *p) { return _mm256_loadu_pd(p); }
+    static void store(double *p, V v) { _mm256_storeu_pd(p, v); }
+    static V set1(double x) { return _mm256_set1_pd(x); }
+    static V add(V a, V b) { return _mm256_add_pd(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+    static V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+    static V div(V a, V b) { return _mm256_div_pd(a, b); }
+    static V fma(V a, V b, V c) { return _mm256_fmadd_pd(a, b, c); }
+    static V max(V a, V b) { return _mm256_max_pd(a, b); }
+    static V min(V a, V b) { return _mm256_min_pd(a, b); }
+};
+
+template<>
+struct Vec<int> {
+    using V = __m256i;
+    static constexpr std::size_t width = 8;
+    static constexpr bool has_mul = true, has_div = false;
+    static V load(int const *p) { return _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p)); }
+    static void store(int *p, V v) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v); }
+    static V set1(int x) { return _mm256_set1_epi32(x); }
+    static V add(V a, V b) { return _mm256_add_epi32(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_epi32(a, b); }
+    static V mul(V a, V b) { return _mm256_mullo_epi32(a, b); }
+    static V fma(V a, V b, V c) { return _mm256_add_epi32(_mm256_mullo_epi32(a, b), c); }
+    static V max(V a, V b) { return _mm256_max_epi32(a, b); }
+    static V min(V a, V b) { return _mm256_min_epi32(a, b); }
+};
+
+#include "simd_kernels.h"
+
+}// namespace avx2
+TENSOR_TARGET_POP()
+
+TENSOR_TARGET_PUSH("avx512f")
+namespace avx512 {
+
+template<class T>
+struct Vec;
+
+template<>
+struct Vec<float> {
+    using V = __m512;
+    static constexpr std::size_t width = 16;
+    static constexpr bool has_mul = true, has_div = true;
+    static V load(float const *p) { return _mm512_loadu_ps(p); }
+    static void store(float *p, V v) { _mm512_storeu_ps(p, v); }
+    static V set1(float x) { return _mm512_set1_ps(x); }
+    static V add(V a, V b) { return _mm512_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm512_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm512_mul_ps(a, b); }
+    static V div(V a, V b) { return _mm512_div_ps(a, b); }
+    static V fma(V a, V b, V c) { return _mm512_fmadd_ps(a, b, c); }
+    // 不带掩码的 _mm512_max_ps 等在 GCC 中以未初始化的值作直通参数，-Wall 下会误报，这里改用全选的掩码形式
+    static V max(V a, V b) { return _mm512_mask_max_ps(a, 0xffff, a, b); }
+    static V min(V a, V b) { return _mm512_mask_min_ps(a, 0xffff, a, b); }
+};
+
+template<>
+struct Vec<double> {
+    using V = __m512d;
+    static constexpr std::size_t width = 8;
+    static constexpr bool has_mul = true, has_div = true;
+    static V load(double const *p) { return _mm512_loadu_pd(p); }
+    static void store(double *p, V v) { _mm512_storeu_pd(p, v); }
+    static V set1(double x) { return _mm512_set1_pd(x); }
+    static V add(V a, V b) { return _mm512_add_pd(a, b); }
+    static V sub(V a, V b) { return _mm512_sub_pd(a, b); }
+    static V mul(V a, V b) { return _mm512_mul_pd(a, b); }
+    static V div(V a, V b) { return _mm512_div_pd(a, b); }
+    static V fma(V a, V b, V c) { return _mm512_fmadd_pd(a, b, c); }
+    static V max(V a, V b) { return _mm512_mask_max_pd(a, 0xff, a, b); }
+    static V min(V a, V b) { return _mm512_mask_min_pd(a, 0xff, a, b); }
+};
+
+template<>
+struct Vec<int> {
+    using V = __m512i;
+    static constexpr std::size_t width = 16;
+    static constexpr bool has_mul = true, has_div = false;
+    static V load(int const *p) { return _mm512_loadu_si512(p); }
+    static void store(int *p, V v) { _mm512_storeu_si512(p, v); }
+    static V set1(int x) { return _mm512_set1_epi32(x); }
+    static V add(V a, V b) { return _mm512_add_epi32(a, b); }
+    static V sub(V a, V b) { return _mm512_sub_epi32(a, b); }
+    static V mul(V a, V b) { return _mm512_mullo_epi32(a, b); }
+    static V fma(V a, V b, V c) { return _mm512_add_epi32(_mm512_mullo_epi32(a, b), c); }
+    static V max(V a, V b) { return _mm512_mask_max_epi32(a, 0xffff, a, b); }
+    static V min(V a, V b) { return _mm512_mask_min_epi32(a, 0xffff, a, b); }
+};
+
+#include "simd_kernels.h"
+
+}// namespace avx512
+TENSOR_TARGET_POP()
+
+#endif// TENSOR_X86
+
+// 核函数表在目标指令集区域之外构造，只取地址，不会在不支持的处理器上执行其中的指令
+template<class Impl, class T>
+Kernels<T> make_kernels() {
+    return {
+        {&Impl::template binary<T, Op::Add>, &Impl::template binary<T, Op::Sub>,
+         &Impl::template binary<T, Op::Mul>, &Impl::template binary<T, Op::Div>},
+        {&Impl::template binary_scalar<T, Op::Add>, &Impl::template binary_scalar<T, Op::Sub>,
+         &Impl::template binary_scalar<T, Op::Mul>, &Impl::template binary_scalar<T, Op::Div>},
+        {&Impl::template binary_rows<T, Op::Add>, &Impl::template binary_rows<T, Op::Sub>,
+         &Impl::template binary_rows<T, Op::Mul>, &Impl::template binary_rows<T, Op::Div>},
+        &Impl::template fma<T>,
+        &Impl::template fma_scalar<T>,
+        {&Impl::template reduce<T, Reduce::Sum>, &Impl::template reduce<T, Reduce::Max>, &Impl::template reduce<T, Reduce::Min>},
+        {&Impl::template accumulate<T, Reduce::Sum>, &Impl::template accumulate<T, Reduce::Max>,
+         &Impl::template accumulate<T, Reduce::Min>},
+        &Impl::template argmax<T>,
+        &Impl::template gemm<T>,
+        Impl::GEMM_MR,
+        Impl::template gemm_nr<T>,
+    };
+}
+
+// 指定指令集上的核函数；不支持的指令集（非 x86 平台）退回标量实现
+template<class T>
+Kernels<T> const &kernels(Isa isa) {
+    static_assert(supported<T>, "SIMD kernels are provided for float, double and int only");
+#if TENSOR_X86
+    static Kernels<T> const table[]{
+        make_kernels<scalar::Impl, T>(),
+        make_kernels<sse2::Impl, T>(),
+        make_kernels<avx2::Impl, T>(),
+        make_kernels<avx512::Impl, T>(),
+    };
+    return table[static_cast<int>(isa)];
+#else
+    (void) isa;
+    static Kernels<T> const table = make_kernels<scalar::Impl, T>();
+    return table;
+#endif
+}
+
+// 以当前指令集执行的便捷入口
+
+template<class T>
+void binary(Op op, T *dst, T const *a, T const *b, std::size_t n) {
+    kernels<T>(active_isa()).binary[static_cast<int>(op)](dst, a, b, n);
+}
+
+template<class T>
+void binary_scalar(Op op, T *dst, T const *a, T s, std::size_t n) {
+    kernels<T>(active_isa()).binary_scalar[static_cast<int>(op)](dst, a, s, n);
+}
+
+template<class T>
+void binary_rows(Op op, T *dst, T const *a, T const *row, std::size_t rows, std::size_t cols) {
+    kernels<T>(active_isa()).binary_rows[static_cast<int>(op)](dst, a, row, rows, cols);
+}
+
+template<class T>
+void fma(T *dst, T const *a, T const *b, T const *c, std::size_t n) {
+    kernels<T>(active_isa()).fma(dst, a, b, c, n);
+}
+
+template<class T>
+void fma_scalar(T *dst, T const *a, T s, T const *c, std::size_t n) {
+    kernels<T>(active_isa()).fma_scalar(dst, a, s, c, n);
+}
+
+template<class T>
+T reduce(Reduce op, T const *a, std::size_t n) {
+    return kernels<T>(active_isa()).reduce[static_cast<int>(op)](a, n);
+}
+
+template<class T>
+void accumulate(Reduce op, T *dst, T const *a, std::size_t n) {
+    kernels<T>(active_isa()).accumulate[static_cast<int>(op)](dst, a, n);
+}
+
+template<class T>
+std::size_t argmax(T const *a, std::size_t n) {
+    return kernels<T>(active_isa()).argmax(a, n);
+}
+
+}// namespace simd
+}// namespace tensor
+
+#endif// __TENSOR_SIMD_H__
@@ -0,0 +1,281 @@
+﻿// 没有包含保护：由 simd.h 在每个指令集的命名空间中各包含一次，
+// 使用包含处定义的 `Vec<T>`（向量类型、宽度及 load/store/set1/add/sub/mul/div/fma/max/min），
+// 并继承包含处的目标指令集。此处不能使用 lambda，它们不一定带上目标指令集。
+
+struct Impl {
+    template<class T, Op op>
+    static constexpr bool vectorized = op == Op::Div ? Vec<T>::has_div : op == Op::Mul ? Vec<T>::has_mul : true;
+
+    template<Op op, class T>
+    static T apply(T a, T b) {
+        switch (op) {
+            case Op::Add:
+                return a + b;
+            case Op::Sub:
+                return a - b;
+            case Op::Mul:
+                return a * b;
+            default:
+                return a / b;
+        }
+    }
+
+    template<Op op, class V>
+    static typename V::V apply_vec(typename V::V a, typename V::V b) {
+        if constexpr (op == Op::Add) {
+            return V::add(a, b);
+        } else if constexpr (op == Op::Sub) {
+            return V::sub(a, b);
+        } else if constexpr (op == Op::Mul) {
+            return V::mul(a, b);
+        } else {
+            return V::div(a, b);
+        }
+    }
+
+    template<class T, Op op>
+    static void binary(T *dst, T const *a, T const *b, std::size_t n) {
+        using V = Vec<T>;
+        constexpr auto W = V::width;
+        std::size_t i = 0;
+        if constexpr (vectorized<T, op>) {
+            // 展开两路，让相邻两次的加载与运算重叠
+            for (; i + 2 * W <= n; i += 2 * W) {
+                auto x0 = apply_vec<op, V>(V::load(a + i), V::load(b + i));
+                auto x1 = apply_vec<op, V>(V::load(a + i + W), V::load(b + i + W));
+                V::store(dst + i, x0);
+                V::store(dst + i + W, x1);
+            }
+            for (; i + W <= n; i += W) {
+                V::store(dst + i, apply_vec<op, V>(V::load(a + i), V::load(b + i)));
+            }
+        }
+        for (; i < n; ++i) {
+            dst[i] = apply<op>(a[i], b[i]);
+        }
+    }
+
+    template<class T, Op op>
+    static void binary_scalar(T *dst, T const *a, T s, std::size_t n) {
+        using V = Vec<T>;
+        constexpr auto W = V::width;
+        std::size_t i = 0;
+        if constexpr (vectorized<T, op>) {
+            auto b = V::set1(s);
+            for (; i + 2 * W <= n; i += 2 * W) {
+                auto x0 = apply_vec<op, V>(V::load(a + i), b);
+                auto x1 = apply_vec<op, V>(V::load(a + i + W), b);
+                V::store(dst + i, x0);
+                V::store(dst + i + W, x1);
+            }
+            for (; i + W <= n; i += W) {
+                V::store(dst + i, apply_vec<op, V>(V::load(a + i), b));
+            }
+        }
+        for (; i < n; ++i) {
+            dst[i] = apply<op>(a[i], s);
+        }
+    }
+
+    template<class T, Op op>
+    static void binary_rows(T *dst, T const *a, T const *row, std::size_t rows, std::size_t cols) {
+        using V = Vec<T>;
+        constexpr auto W = V::width;
+        // 行很短时按整块连续处理：把 row 在缓冲中重复成恰好一个向量，避免每行都有尾部标量运算
+        if constexpr (vectorized<T, op> && W > 1) {
+            if (rows > 0 && cols > 0 && cols < W && W % cols == 0) {
+                T repeated[W];
+                for (std::size_t j = 0; j < W; ++j) {
+                    repeated[j] = row[j % cols];
+                }
+                auto b = V::load(repeated);
+                auto n = rows * cols, i = std::size_t{0};
+                for (; i + W <= n; i += W) {
+                    V::store(dst + i, apply_vec<op, V>(V::load(a + i), b));
+                }
+                for (; i < n; ++i) {
+                    dst[i] = apply<op>(a[i], row[i % cols]);
+                }
+                return;
+            }
+        }
+        for (std::size_t r = 0; r < rows; ++r) {
+            binary<T, op>(dst + r * cols, a + r * cols, row, cols);
+        }
+    }
+
+    template<class T>
+    static void fma(T *dst, T const *a, T const *b, T const *c, std::size_t n) {
+        using V = Vec<T>;
+        constexpr auto W = V::width;
+        std::size_t i = 0;
+        for (; i + 2 * W <= n; i += 2 * W) {
+            auto x0 = V::fma(V::load(a + i), V::load(b + i), V::load(c + i));
+            auto x1 = V::fma(V::load(a + i + W), V::load(b + i + W), V::load(c + i + W));
+            V::store(dst + i, x0);
+            V::store(dst + i + W, x1);
+        }
+        for (; i + W <= n; i += W) {
+            V::store(dst + i, V::fma(V::load(a + i), V::load(b + i), V::load(c + i)));
+        }
+        for (; i < n; ++i) {
+            dst[i] = a[i] * b[i] + c[i];
+        }
+    }
+
+    template<class T>
+    static void fma_scalar(T *dst, T const *a, T s, T const *c, std::size_t n) {
+        using V = Vec<T>;
+        constexpr auto W = V::width;
+        auto b = V::set1(s);
+        std::size_t i = 0;
+        for (; i + 2 * W <= n; i += 2 * W) {
+            auto x0 = V::fma(V::load(a + i), b, V::load(c + i));
+            auto x1 = V::fma(V::load(a + i + W), b, V::load(c + i + W));
+            V::store(dst + i, x0);
+            V::store(dst + i + W, x1);
+        }
+        for (; i + W <= n; i += W) {
+            V::store(dst + i, V::fma(V::load(a + i), b, V::load(c + i)));
+        }
+        for (; i < n; ++i) {
+            dst[i] = a[i] * s + c[i];
+        }
+    }
+
+    template<Reduce op, class T>
+    static T apply_reduce(T a, T b) {
+        switch (op) {
+            case Reduce::Sum:
+                return a + b;
+            case Reduce::Max:
+                return a > b ? a : b;
+            default:
+                return a < b ? a : b;
+        }
+    }
+
+    template<Reduce op, class V>
+    static typename V::V apply_reduce_vec(typename V::V a, typename V::V b) {
+        if constexpr (op == Reduce::Sum) {
+            return V::add(a, b);
+        } else if constexpr (op == Reduce::Max) {
+            return V::max(a, b);
+        } else {
+            return V::min(a, b);
+        }
+    }
+
+    // 求和时每条通道在一块中顺序累加的元素数；更长的输入对半拆分后成对相加，舍入误差随长度对数增长
+    static constexpr std::size_t PAIRWISE_LANE = 32;
+
+    template<class T, Reduce op>
+    static T reduce(T const *a, std::size_t n) {
+        using V = Vec<T>;
+        constexpr auto W = V::width;
+        if constexpr (op == Reduce::Sum) {
+            if (n > 4 * W * PAIRWISE_LANE) {
+                auto half = n / 2 / (4 * W) * (4 * W);
+                return reduce<T, op>(a, half) + reduce<T, op>(a + half, n - half);
+            }
+        }
+        std::size_t i = 0;
+        T ans;
+        if (n >= 4 * W) {
+            // 四个独立的累加器，掩盖运算延迟；最后各通道按二叉树合并
+            auto x0 = V::load(a), x1 = V::load(a + W), x2 = V::load(a + 2 * W), x3 = V::load(a + 3 * W);
+            for (i = 4 * W; i + 4 * W <= n; i += 4 * W) {
+                x0 = apply_reduce_vec<op, V>(x0, V::load(a + i));
+                x1 = apply_reduce_vec<op, V>(x1, V::load(a + i + W));
+                x2 = apply_reduce_vec<op, V>(x2, V::load(a + i + 2 * W));
+                x3 = apply_reduce_vec<op, V>(x3, V::load(a + i + 3 * W));
+            }
+            T lanes[W];
+            V::store(lanes, apply_reduce_vec<op, V>(apply_reduce_vec<op, V>(x0, x1), apply_reduce_vec<op, V>(x2, x3)));
+            for (auto w = W; w > 1; w /= 2) {
+                for (std::size_t j = 0; j < w / 2; ++j) {
+                    lanes[j] = apply_reduce<op>(lanes[j], lanes[j + w / 2]);
+                }
+            }
+            ans = lanes[0];
+        } else {
+            ans = a[0];
+            i = 1;
+        }
+        for (; i < n; ++i) {
+            ans = apply_reduce<op>(ans, a[i]);
+        }
+        return ans;
+    }
+
+    template<class T, Reduce op>
+    static void accumulate(T *dst, T const *a, std::size_t n) {
+        using V = Vec<T>;
+        constexpr auto W = V::width;
+        std::size_t i = 0;
+        for (; i + 2 * W <= n; i += 2 * W) {
+            auto x0 = apply_reduce_vec<op, V>(V::load(dst + i), V::load(a + i));
+            auto x1 = apply_reduce_vec<op, V>(V::load(dst + i + W), V::load(a + i + W));
+            V::store(dst + i, x0);
+            V::store(dst + i + W, x1);
+        }
+        for (; i + W <= n; i += W) {
+            V::store(dst + i, apply_reduce_vec<op, V>(V::load(dst + i), V::load(a + i)));
+        }
+        for (; i < n; ++i) {
+            dst[i] = apply_reduce<op>(dst[i], a[i]);
+        }
+    }
+
+    // 逐块求最大值，只在最大值所在的块中回头查找下标，数据基本只从内存读一遍
+    template<class T>
+    static std::size_t argmax(T const *a, std::size_t n) {
+        constexpr std::size_t BLOCK = 2048;
+        auto best = a[0];
+        std::size_t block = 0;
+        for (std::size_t b = 0; b < n; b += BLOCK) {
+            auto m = reduce<T, Reduce::Max>(a + b, n - b < BLOCK ? n - b : BLOCK);
+            if (m > best) {
+                best = m;
+                block = b;
+            }
+        }
+        for (auto i = block; i < n; ++i) {
+            if (a[i] == best) {
+                return i;
+            }
+        }
+        return block;
+    }
+
+    // 矩阵乘的寄存器块：GEMM_MR 行、两个向量宽的 gemm_nr 列，共 2 * GEMM_MR 个累加器留在寄存器中
+    static constexpr std::size_t GEMM_MR = 6;
+    template<class T>
+    static constexpr std::size_t gemm_nr = 2 * Vec<T>::width;
+
+    template<class T>
+    static void gemm(std::size_t k, T const *a, T const *b, T *c, std::ptrdiff_t ldc, bool accumulate) {
+        using V = Vec<T>;
+        constexpr auto W = V::width, MR = GEMM_MR;
+        typename V::V c0[MR], c1[MR];
+        for (std::size_t i = 0; i < MR; ++i) {
+            c0[i] = c1[i] = V::set1(T{});
+        }
+        for (std::size_t p = 0; p < k; ++p, a += MR, b += 2 * W) {
+            auto b0 = V::load(b), b1 = V::load(b + W);
+            for (std::size_t i = 0; i < MR; ++i) {
+                auto x = V::set1(a[i]);
+                c0[i] = V::fma(x, b0, c0[i]);
+                c1[i] = V::fma(x, b1, c1[i]);
+            }
+        }
+        for (std::size_t i = 0; i < MR; ++i, c += ldc) {
+            if (accumulate) {
+                c0[i] = V::add(c0[i], V::load(c));
+                c1[i] = V::add(c1[i], V::load(c + W));
+            }
+            V::store(c, c0[i]);
+            V::store(c + W, c1[i]);
+        }
+    }
+};
@@ -0,0 +1,161 @@
+﻿#ifndef __TENSOR_STATIC_TENSOR_H__
+#define __TENSOR_STATIC_TENSOR_H__
+
+// 形状在编译期确定的张量。
+// 维度长度是模板实参，DYNAMIC 表示该维在运行时给出，可以与固定的维度混用；
+// 下标按 Horner 法则展开为 ((i0 * e1 + i1) * e2 + i2) ... 的乘加链，固定的长度和步长都是编译期常量，
+// 没有循环，也不必从内存读取形状。
+
+#include "storage.h"
+#include "view.h"
+#include <array>
+#include <utility>
+
+namespace tensor {
+
+constexpr std::size_t DYNAMIC = ~std::size_t{0};
+
+template<std::size_t... Extents>
+struct StaticShape {
+    static_assert(sizeof...(Extents) > 0, "A static shape has at least one dimension");
+    static constexpr unsigned int rank = sizeof...(Extents);
+    static constexpr std::size_t extents[]{Extents...};
+    static constexpr std::size_t dynamic_count = ((Extents == DYNAMIC ? 1 : 0) + ... + 0);
+
+    // 运行时给出的维度长度，按维度顺序排列
+    std::array<std::size_t, dynamic_count> dynamic{};
+
+    // 第 I 维之前有多少个运行时维度
+    template<unsigned int I>
+    static constexpr std::size_t dynamic_index() {
+        std::size_t ans = 0;
+        for (auto i = 0u; i < I; ++i) {
+            ans += extents[i] == DYNAMIC;
+        }
+        return ans;
+    }
+
+    template<unsigned int I>
+    constexpr std::size_t extent() const {
+        if constexpr (extents[I] == DYNAMIC) {
+            return dynamic[dynamic_index<I>()];
+        } else {
+            return extents[I];
+        }
+    }
+
+    // 第 I 维的步长在编译期已知时的值，否则为 DYNAMIC
+    template<unsigned int I>
+    static constexpr std::size_t static_stride() {
+        std::size_t ans = 1;
+        for (auto i = I + 1; i < rank; ++i) {
+            if (extents[i] == DYNAMIC) {
+                return DYNAMIC;
+            }
+            ans *= extents[i];
+        }
+        return ans;
+    }
+
+    template<unsigned int I>
+    constexpr std::size_t stride() const {
+        if constexpr (static_stride<I>() != DYNAMIC) {
+            return static_stride<I>();
+        } else {
+            return stride_impl<I>(std::make_index_sequence<rank - I - 1>{});
+        }
+    }
+
+    constexpr std::size_t size() const {
+        return size_impl(std::make_index_sequence<rank>{});
+    }
+
+    template<class... Indices>
+    constexpr std::size_t offset(Indices... indices) const {
+        static_assert(sizeof...(Indices) == rank, "One index per dimension");
+        return offset_impl(std::make_index_sequence<rank>{}, static_cast<std::size_t>(indices)...);
+    }
+
+    // 运行时形状，可用于构造视图
+    std::array<std::size_t, rank> runtime() const {
+        return runtime_impl(std::make_index_sequence<rank>{});
+    }
+
+private:
+    template<unsigned int I, std::size_t... J>
+    constexpr std::size_t stride_impl(std::index_sequence<J...>) const {
+        return (std::size_t{1} * ... * extent<I + 1 + J>());
+    }
+
+    template<std::size_t... I>
+    constexpr std::size_t size_impl(std::index_sequence<I...>) const {
+        return (std::size_t{1} * ... * extent<I>());
+    }
+
+    // Horner 法则的一步：累积值乘以第 I 维的长度再加上第 I 维的下标
+    template<unsigned int I>
+    constexpr std::size_t horner(std::size_t acc, std::size_t index) const {
+        DEBUG_ASSERT(index < extent<I>(), "Index " << index << " out of range " << extent<I>() << " at axis " << I);
+        return acc * extent<I>() + index;
+    }
+
+    template<std::size_t... I, class... Indices>
+    constexpr std::size_t offset_impl(std::index_sequence<I...>, Indices... indices) const {
+        std::size_t ans = 0;
+        ((ans = horner<I>(ans, indices)), ...);
+        return ans;
+    }
+
+    template<std::size_t... I>
+    std::array<std::size_t, rank> runtime_impl(std::index_sequence<I...>) const {
+        return {extent<I>()...};
+    }
+};
+
+// 形状为 StaticShape<Extents...> 的张量，运行时维度的长度按顺序传给构造函数；数据从缓冲池分配并清零
+template<class T, std::size_t... Extents>
+class StaticTensor {
+public:
+    using Shape = StaticShape<Extents...>;
+    using value_type = T;
+    static constexpr unsigned int rank = Shape::rank;
+
+    template<class... Dynamic>
+    explicit StaticTensor(Dynamic... dynamic) : shape_{{static_cast<std::size_t>(dynamic)...}} {
+        static_assert(sizeof...(Dynamic) == Shape::dynamic_count, "One length per DYNAMIC dimension");
+        storage_ = Storage<T>::allocate(shape_.size());
+        std::fill_n(storage_.get(), storage_.size(), T{});
+    }
+
+    Shape const &shape() const { return shape_; }
+    std::size_t size() const { return shape_.size(); }
+    T *data() const { return storage_.get(); }
+
+    template<class... Indices>
+    T &operator()(Indices... indices) {
+        return storage_.get()[shape_.offset(indices...)];
+    }
+    template<class... Indices>
+    T const &operator()(Indices... indices) const {
+        return storage_.get()[shape_.offset(indices...)];
+    }
+
+private:
+    Shape shape_;
+    Storage<T> storage_;
+};
+
+template<class T, std::size_t... Extents>
+TensorView<T> view(StaticTensor<T, Extents...> &t) {
+    auto shape = t.shape().runtime();
+    return {t.data(), StaticTensor<T, Extents...>::rank, shape.data()};
+}
+template<class T, std::size_t... Extents>
+TensorView<T const> view(StaticTensor<T, Extents...> const &t) {
+    auto shape = t.shape().runtime();
+    return {t.data(), StaticTensor<T, Extents...>::rank, shape.data()};
+}
+
+}// namespace tensor
+
+#endif// __TENSOR_STATIC_TENSOR_H__
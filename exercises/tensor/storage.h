@@ -0,0 +1,211 @@
+﻿#ifndef __TENSOR_STORAGE_H__
+#define __TENSOR_STORAGE_H__
+
+// 张量的数据缓冲区。
+// 自行分配的缓冲区按 64 字节（缓存行，也是 AVX-512 向量的宽度）对齐，并经过按大小分级的缓冲池：
+// 释放的缓冲区留在池中，之后同一级别的分配直接复用，循环中反复创建销毁张量不会每次都调用 malloc。
+// 也可以接管（adopt）或借用（borrow）外部的缓冲区，不复制数据。
+
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace tensor {
+
+constexpr std::size_t ALIGNMENT = 64;
+
+class BufferPool {
+public:
+    // 超过此大小的缓冲区直接分配和释放，不进入池
+    static constexpr std::size_t MAX_POOLED = std::size_t{1} << 28;
+    // 每一级最多缓存的缓冲区数，及池中缓存的总字节数上限
+    static constexpr std::size_t MAX_CACHED = 16, MAX_CACHED_BYTES = std::size_t{1} << 30;
+
+    BufferPool() {
+        // 每个 2 的幂之间再分 4 级，向上取整浪费的空间不超过 25%
+        for (std::size_t size = ALIGNMENT; size < MAX_POOLED; size *= 2) {
+            for (std::size_t k = 0; k < 4; ++k) {
+                classes_.push_back(size + size / 4 * k);
+            }
+        }
+        classes_.push_back(MAX_POOLED);
+        free_.resize(classes_.size());
+    }
+    ~BufferPool() {
+        trim();
+    }
+    BufferPool(BufferPool const &) = delete;
+    BufferPool &operator=(BufferPool const &) = delete;
+
+    // 分配至少 `bytes` 字节、按 ALIGNMENT 对齐的缓冲区，`capacity` 返回实际大小，释放时需原样交回
+    void *allocate(std::size_t bytes, std::size_t &capacity) {
+        auto it = std::lower_bound(classes_.begin(), classes_.end(), std::max<std::size_t>(bytes, 1));
+        if (it == classes_.end()) {
+            capacity = bytes;
+            return ::operator new(bytes, std::align_val_t{ALIGNMENT});
+        }
+        capacity = *it;
+        auto &list = free_[it - classes_.begin()];
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!list.empty()) {
+                auto ans = list.back();
+                list.pop_back();
+                cached_ -= capacity;
+                ++hits_;
+                return ans;
+            }
+            ++misses_;
+        }
+        return ::operator new(capacity, std::align_val_t{ALIGNMENT});
+    }
+
+    void deallocate(void *p, std::size_t capacity) {
+        if (!p) {
+            return;
+        }
+        auto it = std::lower_bound(classes_.begin(), classes_.end(), capacity);
+        if (it != classes_.end() && *it == capacity) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto &list = free_[it - classes_.begin()];
+            if (list.size() < MAX_CACHED && cached_ + capacity <= MAX_CACHED_BYTES) {
+                list.push_back(p);
+                cached_ += capacity;
+                return;
+            }
+        }
+        ::operator delete(p, std::align_val_t{ALIGNMENT});
+    }
+
+    // 释放池中缓存的全部缓冲区
+    void trim() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &list : free_) {
+            for (auto p : list) {
+                ::operator delete(p, std::align_val_t{ALIGNMENT});
+            }
+            list.clear();
+        }
+        cached_ = 0;
+    }
+
+    // 从池中复用与新分配的次数
+    std::size_t hits() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return hits_;
+    }
+    std::size_t misses() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return misses_;
+    }
+
+private:
+    std::vector<std::size_t> classes_;
+    std::vector<std::vector<void *>> free_;
+    mutable std::mutex mutex_;
+    std::size_t cached_ = 0, hits_ = 0, misses_ = 0;
+};
+
+// 默认的缓冲池。有意不析构：静态存储期的张量可能在程序退出时晚于它释放
+inline BufferPool &default_buffer_pool() {
+    static auto pool = new BufferPool;
+    return *pool;
+}
+
+// `n` 个 `T` 的缓冲区，只能移动。三种来源：
+// allocate 从缓冲池分配（平凡类型不初始化，其他类型值初始化），adopt 接管外部缓冲区并在析构时调用给定的释放函数，
+// borrow 借用外部缓冲区，析构时什么也不做，调用者保证其生存期
+template<class T>
+class Storage {
+public:
+    using Deleter = void (*)(T *, std::size_t);
+
+    Storage() = default;
+
+    static Storage allocate(std::size_t n) {
+        Storage ans;
+        ans.data_ = static_cast<T *>(default_buffer_pool().allocate(n * sizeof(T), ans.capacity_));
+        ans.size_ = n;
+        ans.pooled_ = true;
+        if constexpr (!std::is_trivially_default_constructible<T>::value) {
+            for (std::size_t i = 0; i < n; ++i) {
+                new (ans.data_ + i) T();
+            }
+        }
+        return ans;
+    }
+
+    static Storage adopt(T *data, std::size_t n, Deleter deleter = [](T *p, std::size_t) { delete[] p; }) {
+        Storage ans;
+        ans.data_ = data;
+        ans.size_ = n;
+        ans.deleter_ = deleter;
+        return ans;
+    }
+
+    static Storage borrow(T *data, std::size_t n) {
+        Storage ans;
+        ans.data_ = data;
+        ans.size_ = n;
+        return ans;
+    }
+
+    Storage(Storage &&others) noexcept
+        : data_(std::exchange(others.data_, nullptr)),
+          size_(std::exchange(others.size_, 0)),
+          capacity_(std::exchange(others.capacity_, 0)),
+          pooled_(std::exchange(others.pooled_, false)),
+          deleter_(std::exchange(others.deleter_, nullptr)) {}
+    Storage &operator=(Storage &&others) noexcept {
+        if (this != &others) {
+            release();
+            data_ = std::exchange(others.data_, nullptr);
+            size_ = std::exchange(others.size_, 0);
+            capacity_ = std::exchange(others.capacity_, 0);
+            pooled_ = std::exchange(others.pooled_, false);
+            deleter_ = std::exchange(others.deleter_, nullptr);
+        }
+        return *this;
+    }
+    Storage(Storage const &) = delete;
+    Storage &operator=(Storage const &) = delete;
+    ~Storage() {
+        release();
+    }
+
+    T *get() const { return data_; }
+    std::size_t size() const { return size_; }
+    // 析构时是否释放缓冲区（借用的缓冲区不释放）
+    bool owns() const { return pooled_ || deleter_; }
+
+private:
+    void release() {
+        if (pooled_) {
+            if constexpr (!std::is_trivially_destructible<T>::value) {
+                for (std::size_t i = 0; i < size_; ++i) {
+                    data_[i].~T();
+                }
+            }
+            default_buffer_pool().deallocate(data_, capacity_);
+        } else if (deleter_) {
+            deleter_(data_, size_);
+        }
+        data_ = nullptr;
+        size_ = capacity_ = 0;
+        pooled_ = false;
+        deleter_ = nullptr;
+    }
+
+    T *data_ = nullptr;
+    std::size_t size_ = 0, capacity_ = 0;
+    bool pooled_ = false;
+    Deleter deleter_ = nullptr;
+};
+
+}// namespace tensor
+
+#endif// __TENSOR_STORAGE_H__
@@ -0,0 +1,212 @@
+﻿#ifndef __TENSOR_VIEW_H__
+#define __TENSOR_VIEW_H__
+
+// 不拥有数据的张量视图：形状、步长（以元素计）和相对 `data` 的偏移。
+// 切片、转置、重排、连续数据的变形、负步长的翻转和步长为 0 的广播都只改变这三者，不复制数据；
+// broadcast_inplace、assign 等核函数既接受视图，也接受拥有数据的连续张量。
+
+#include "broadcast.h"
+#include <initializer_list>
+#include <type_traits>
+
+namespace tensor {
+
+template<class T>
+struct TensorView {
+    using value_type = T;
+
+    T *data;
+    std::ptrdiff_t offset;
+    unsigned int rank;
+    std::size_t shape[MAX_RANK];
+    std::ptrdiff_t strides[MAX_RANK];
+
+    // 行主序连续存储的张量
+    template<class Dim>
+    TensorView(T *data_, unsigned int rank_, Dim const *shape_)
+        : data(data_), offset(0), rank(rank_), shape{}, strides{} {
+        ASSERT(rank <= MAX_RANK, "Rank " << rank << " exceeds " << MAX_RANK);
+        for (auto i = 0u; i < rank; ++i) {
+            shape[i] = static_cast<std::size_t>(shape_[i]);
+        }
+        contiguous_strides(rank, shape, strides);
+    }
+
+    template<class Dim>
+    TensorView(T *data_, unsigned int rank_, Dim const *shape_, std::ptrdiff_t const *strides_, std::ptrdiff_t offset_ = 0)
+        : data(data_), offset(offset_), rank(rank_), shape{}, strides{} {
+        ASSERT(rank <= MAX_RANK, "Rank " << rank << " exceeds " << MAX_RANK);
+        for (auto i = 0u; i < rank; ++i) {
+            shape[i] = static_cast<std::size_t>(shape_[i]);
+            strides[i] = strides_[i];
+        }
+    }
+
+    // 只读视图
+    template<class U = T, class = std::enable_if_t<!std::is_const<U>::value>>
+    operator TensorView<U const>() const {
+        return {data, rank, shape, strides, offset};
+    }
+
+    // 下标全为 0 的元素
+    T *origin() const {
+        return data + offset;
+    }
+
+    std::size_t size() const {
+        std::size_t ans = 1;
+        for (auto i = 0u; i < rank; ++i) {
+            ans *= shape[i];
+        }
+        return ans;
+    }
+
+    // 是否行主序连续，长度为 1 的维度不论步长
+    bool is_contiguous() const {
+        std::ptrdiff_t stride = 1;
+        for (auto i = rank; i-- > 0;) {
+            if (shape[i] != 1 && strides[i] != stride) {
+                return false;
+            }
+            stride *= static_cast<std::ptrdiff_t>(shape[i]);
+        }
+        return true;
+    }
+
+    T &at(std::size_t const *indices) const {
+        auto index = offset;
+        for (auto i = 0u; i < rank; ++i) {
+            DEBUG_ASSERT(indices[i] < shape[i], "Index " << indices[i] << " out of range " << shape[i] << " at axis " << i);
+            index += static_cast<std::ptrdiff_t>(indices[i]) * strides[i];
+        }
+        return data[index];
+    }
+    T &operator()(std::initializer_list<std::size_t> indices) const {
+        ASSERT(indices.size() == rank, "Expected " << rank << " indices, got " << indices.size());
+        return at(indices.begin());
+    }
+
+    // 第 `axis` 维取 [begin, end) 中每隔 `step` 个的元素
+    TensorView slice(unsigned int axis, std::size_t begin, std::size_t end, std::size_t step = 1) const {
+        ASSERT(axis < rank, "Axis " << axis << " out of range " << rank);
+        ASSERT(begin <= end && end <= shape[axis], "Slice [" << begin << ", " << end << ") out of range " << shape[axis]);
+        ASSERT(step > 0, "Slice step must be positive, use flip to reverse");
+        auto ans = *this;
+        ans.offset += static_cast<std::ptrdiff_t>(begin) * strides[axis];
+        ans.shape[axis] = (end - begin + step - 1) / step;
+        ans.strides[axis] *= static_cast<std::ptrdiff_t>(step);
+        return ans;
+    }
+
+    // 固定第 `axis` 维的下标，结果少一维
+    TensorView select(unsigned int axis, std::size_t index) const {
+        ASSERT(axis < rank, "Axis " << axis << " out of range " << rank);
+        ASSERT(index < shape[axis], "Index " << index << " out of range " << shape[axis]);
+        auto ans = *this;
+        ans.offset += static_cast<std::ptrdiff_t>(index) * strides[axis];
+        for (auto i = axis; i + 1 < rank; ++i) {
+            ans.shape[i] = shape[i + 1];
+            ans.strides[i] = strides[i + 1];
+        }
+        --ans.rank;
+        return ans;
+    }
+
+    // 结果的第 i 维是原来的第 `axes[i]` 维
+    TensorView permute(unsigned int const *axes) const {
+        auto ans = *this;
+        unsigned int seen = 0;
+        for (auto i = 0u; i < rank; ++i) {
+            ASSERT(axes[i] < rank && !(seen & (1u << axes[i])), "Axes must be a permutation of 0.." << rank - 1);
+            seen |= 1u << axes[i];
+            ans.shape[i] = shape[axes[i]];
+            ans.strides[i] = strides[axes[i]];
+        }
+        return ans;
+    }
+    TensorView permute(std::initializer_list<unsigned int> axes) const {
+        ASSERT(axes.size() == rank, "Expected " << rank << " axes, got " << axes.size());
+        return permute(axes.begin());
+    }
+
+    TensorView transpose(unsigned int a, unsigned int b) const {
+        ASSERT(a < rank && b < rank, "Axes " << a << ", " << b << " out of range " << rank);
+        auto ans = *this;
+        std::swap(ans.shape[a], ans.shape[b]);
+        std::swap(ans.strides[a], ans.strides[b]);
+        return ans;
+    }
+
+    // 连续视图换一个元素总数相同的形状
+    template<class Dim>
+    TensorView reshape(unsigned int rank_, Dim const *shape_) const {
+        ASSERT(is_contiguous(), "Only contiguous views can be reshaped without a copy");
+        TensorView ans(data, rank_, shape_);
+        ans.offset = offset;
+        ASSERT(ans.size() == size(), "Cannot reshape " << size() << " elements into " << ans.size());
+        return ans;
+    }
+    TensorView reshape(std::initializer_list<std::size_t> shape_) const {
+        return reshape(static_cast<unsigned int>(shape_.size()), shape_.begin());
+    }
+
+    // 第 `axis` 维反向
+    TensorView flip(unsigned int axis) const {
+        ASSERT(axis < rank, "Axis " << axis << " out of range " << rank);
+        auto ans = *this;
+        if (shape[axis] > 0) {
+            ans.offset += static_cast<std::ptrdiff_t>(shape[axis] - 1) * strides[axis];
+        }
+        ans.strides[axis] = -strides[axis];
+        return ans;
+    }
+
+    // 右对齐地单向广播到 `rank_` 阶的 `shape_`，被广播的维度步长为 0
+    template<class Dim>
+    TensorView broadcast_to(unsigned int rank_, Dim const *shape_) const {
+        ASSERT(rank_ <= MAX_RANK, "Rank " << rank_ << " exceeds " << MAX_RANK);
+        auto ans = *this;
+        ans.rank = rank_;
+        for (auto i = 0u; i < rank_; ++i) {
+            ans.shape[i] = static_cast<std::size_t>(shape_[i]);
+        }
+        broadcast_strides(rank_, shape_, rank, shape, strides, ans.strides);
+        return ans;
+    }
+    TensorView broadcast_to(std::initializer_list<std::size_t> shape_) const {
+        return broadcast_to(static_cast<unsigned int>(shape_.size()), shape_.begin());
+    }
+};
+
+template<class T>
+constexpr bool is_view = false;
+template<class T>
+constexpr bool is_view<TensorView<T>> = true;
+
+// 连续张量 `Tensor` 的元素类型，`Tensor` 为 const 时元素也为 const
+template<class Tensor>
+using element_t = std::conditional_t<std::is_const<Tensor>::value,
+                                     std::remove_pointer_t<decltype(std::declval<Tensor &>().data)> const,
+                                     std::remove_pointer_t<decltype(std::declval<Tensor &>().data)>>;
+
+// 带有数组成员 `shape` 和指针成员 `data` 的连续张量（如练习中的 `Tensor4D<T>` 和 `Tensor<N, T>`）的视图；
+// 视图本身原样返回
+template<class Tensor, class = std::enable_if_t<!is_view<std::remove_const_t<Tensor>>>>
+TensorView<element_t<Tensor>> view(Tensor &t) {
+    return {t.data, static_cast<unsigned int>(std::extent<decltype(t.shape)>::value), t.shape};
+}
+template<class T>
+TensorView<T> view(TensorView<T> const &v) {
+    return v;
+}
+
+// dst = op(dst, src)，`src` 单向广播到 `dst` 的形状
+template<class T, class S, class Op>
+void broadcast_inplace(TensorView<T> const &dst, TensorView<S> const &src, Op op) {
+    static_assert(std::is_same<std::remove_const_t<S>, T>::value, "Operands must have the same element type");
+    broadcast_inplace(dst.origin(), dst.rank, dst.shape, dst.strides, src.origin(), src.rank, src.shape, src.strides, op);
+}
+
+}// namespace tensor
+
+#endif// __TENSOR_VIEW_H__
@@ -0,0 +1,41 @@
+﻿#include "../pch.h"
+
+// 合并编译的第 0 批：练习 00 ~ 08。
+// 每个练习放进独立的命名空间，练习中的 `main` 由 unity/main.cpp 按编号调用；
+// 练习引用的标准库头文件都已由 pch.h 在全局命名空间中引入，这里再次引入不会生效。
+
+namespace exercise00 {
+#include "../00_hello_world/main.cpp"
+}
+
+namespace exercise01 {
+#include "../01_variable&add/main.cpp"
+}
+
+namespace exercise02 {
+#include "../02_function/main.cpp"
+}
+
+namespace exercise03 {
+#include "../03_argument&parameter/main.cpp"
+}
+
+namespace exercise04 {
+#include "../04_static/main.cpp"
+}
+
+namespace exercise05 {
+#include "../05_constexpr/main.cpp"
+}
+
+namespace exercise06 {
+#include "../06_array/main.cpp"
+}
+
+namespace exercise07 {
+#include "../07_loop/main.cpp"
+}
+
+namespace exercise08 {
+#include "../08_pointer/main.cpp"
+}
@@ -0,0 +1,41 @@
+﻿#include "../pch.h"
+
+// 合并编译的第 1 批：练习 09 ~ 17。
+// 每个练习放进独立的命名空间，练习中的 `main` 由 unity/main.cpp 按编号调用；
+// 练习引用的标准库头文件都已由 pch.h 在全局命名空间中引入，这里再次引入不会生效。
+
+namespace exercise09 {
+#include "../09_enum&union/main.cpp"
+}
+
+namespace exercise10 {
+#include "../10_trivial/main.cpp"
+}
+
+namespace exercise11 {
+#include "../11_method/main.cpp"
+}
+
+namespace exercise12 {
+#include "../12_method_const/main.cpp"
+}
+
+namespace exercise13 {
+#include "../13_class/main.cpp"
+}
+
+namespace exercise14 {
+#include "../14_class_destruct/main.cpp"
+}
+
+namespace exercise15 {
+#include "../15_class_clone/main.cpp"
+}
+
+namespace exercise16 {
+#include "../16_class_move/main.cpp"
+}
+
+namespace exercise17 {
+#include "../17_class_derive/main.cpp"
+}
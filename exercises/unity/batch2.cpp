@@ -0,0 +1,41 @@
+﻿#include "../pch.h"
+
+// 合并编译的第 2 批：练习 18 ~ 26。
+// 每个练习放进独立的命名空间，练习中的 `main` 由 unity/main.cpp 按编号调用；
+// 练习引用的标准库头文件都已由 pch.h 在全局命名空间中引入，这里再次引入不会生效。
+
+namespace exercise18 {
+#include "../18_class_virtual/main.cpp"
+}
+
+namespace exercise19 {
+#include "../19_class_virtual_destruct/main.cpp"
+}
+
+namespace exercise20 {
+#include "../20_function_template/main.cpp"
+}
+
+namespace exercise21 {
+#include "../21_runtime_datatype/main.cpp"
+}
+
+namespace exercise22 {
+#include "../22_class_template/main.cpp"
+}
+
+namespace exercise23 {
+#include "../23_template_const/main.cpp"
+}
+
+namespace exercise24 {
+#include "../24_std_array/main.cpp"
+}
+
+namespace exercise25 {
+#include "../25_std_vector/main.cpp"
+}
+
+namespace exercise26 {
+#include "../26_std_vector_bool/main.cpp"
+}
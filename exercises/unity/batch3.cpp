@@ -0,0 +1,33 @@
+﻿#include "../pch.h"
+
+// 合并编译的第 3 批：练习 27 ~ 33。
+// 每个练习放进独立的命名空间，练习中的 `main` 由 unity/main.cpp 按编号调用；
+// 练习引用的标准库头文件都已由 pch.h 在全局命名空间中引入，这里再次引入不会生效。
+
+namespace exercise27 {
+#include "../27_strides/main.cpp"
+}
+
+namespace exercise28 {
+#include "../28_std_string/main.cpp"
+}
+
+namespace exercise29 {
+#include "../29_std_map/main.cpp"
+}
+
+namespace exercise30 {
+#include "../30_std_unique_ptr/main.cpp"
+}
+
+namespace exercise31 {
+#include "../31_std_shared_ptr/main.cpp"
+}
+
+namespace exercise32 {
+#include "../32_std_transform/main.cpp"
+}
+
+namespace exercise33 {
+#include "../33_std_accumulate/main.cpp"
+}
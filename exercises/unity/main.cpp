@@ -0,0 +1,90 @@
+﻿#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+// 合并编译模式下所有练习链接进同一个可执行文件，由编号选择运行哪一个：
+// xmake run exercises <exercise number>
+
+namespace exercise00 { int main(int, char **); }
+namespace exercise01 { int main(int, char **); }
+namespace exercise02 { int main(int, char **); }
+namespace exercise03 { int main(int, char **); }
+namespace exercise04 { int main(int, char **); }
+namespace exercise05 { int main(int, char **); }
+namespace exercise06 { int main(int, char **); }
+namespace exercise07 { int main(int, char **); }
+namespace exercise08 { int main(int, char **); }
+namespace exercise09 { int main(int, char **); }
+namespace exercise10 { int main(int, char **); }
+namespace exercise11 { int main(int, char **); }
+namespace exercise12 { int main(int, char **); }
+namespace exercise13 { int main(int, char **); }
+namespace exercise14 { int main(int, char **); }
+namespace exercise15 { int main(int, char **); }
+namespace exercise16 { int main(int, char **); }
+namespace exercise17 { int main(int, char **); }
+namespace exercise18 { int main(int, char **); }
+namespace exercise19 { int main(int, char **); }
+namespace exercise20 { int main(int, char **); }
+namespace exercise21 { int main(int, char **); }
+namespace exercise22 { int main(int, char **); }
+namespace exercise23 { int main(int, char **); }
+namespace exercise24 { int main(int, char **); }
+namespace exercise25 { int main(int, char **); }
+namespace exercise26 { int main(int, char **); }
+namespace exercise27 { int main(int, char **); }
+namespace exercise28 { int main(int, char **); }
+namespace exercise29 { int main(int, char **); }
+namespace exercise30 { int main(int, char **); }
+namespace exercise31 { int main(int, char **); }
+namespace exercise32 { int main(int, char **); }
+namespace exercise33 { int main(int, char **); }
+
+static int (*const EXERCISES[])(int, char **){
+    exercise00::main,
+    exercise01::main,
+    exercise02::main,
+    exercise03::main,
+    exercise04::main,
+    exercise05::main,
+    exercise06::main,
+    exercise07::main,
+    exercise08::main,
+    exercise09::main,
+    exercise10::main,
+    exercise11::main,
+    exercise12::main,
+    exercise13::main,
+    exercise14::main,
+    exercise15::main,
+    exercise16::main,
+    exercise17::main,
+    exercise18::main,
+    exercise19::main,
+    exercise20::main,
+    exercise21::main,
+    exercise22::main,
+    exercise23::main,
+    exercise24::main,
+    exercise25::main,
+    exercise26::main,
+    exercise27::main,
+    exercise28::main,
+    exercise29::main,
+    exercise30::main,
+    exercise31::main,
+    exercise32::main,
+    exercise33::main,
+};
+
+int main(int argc, char **argv) {
+    constexpr auto count = static_cast<int>(sizeof(EXERCISES) / sizeof(*EXERCISES));
+    int num;
+    if (argc < 2 || 1 != std::sscanf(argv[1], "%d", &num) || num < 0 || num >= count) {
+        std::cerr << "Usage: xmake run exercises <exercise number>" << std::endl;
+        return EXIT_FAILURE;
+    }
+    // 练习看到的参数与单独运行时一致
+    argv[1] = argv[0];
+    return EXERCISES[num](argc - 1, argv + 1);
+}
@@ -4,6 +4,69 @@ set_warnings("all")
 set_kind("binary")
 set_languages("cxx17")
 
+-- release 模式下 DEBUG_ASSERT 不产生任何代码，`xmake f --audit=y` 开启 AUDIT_ASSERT，见 exercise.h
+if is_mode("release") then
+    add_defines("NDEBUG")
+end
+
+-- 张量库（tensor/parallel.h）的线程池使用 std::thread
+if is_plat("linux") then
+    add_syslinks("pthread")
+end
+
+option("audit")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Enable the expensive AUDIT_ASSERT checks of the exercises")
+option_end()
+
+if has_config("audit") then
+    add_defines("EXERCISE_AUDIT")
+end
+
+-- 合并编译：`xmake f --unity=y` 后所有练习分 4 批合并为少数几个编译单元，
+-- 共用预编译头 pch.h（exercise.h 及练习用到的标准库头文件），链接为一个可执行文件，
+-- 用 `xmake run exercises <exercise number>` 运行指定练习。
+-- 此模式下各练习的独立目标不再默认构建，但仍可单独构建运行。
+option("unity")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Build all exercises as one binary from jumbo translation units with a precompiled header")
+option_end()
+
+if has_config("unity") then
+    set_default(false)
+
+    target("exercises")
+        set_default(true)
+        set_pcxxheader("pch.h")
+        add_files("unity/*.cpp")
+    target_end()
+end
+
+-- 共享库：`xmake f --shared=y` 后每个练习构建为导出 `learn_exercise_entry` 的共享库 exerciseNN_shared，
+-- 由 `xmake run summary --fork-server` 在预先加载它们的 fork 服务器中运行，省去每个练习的 exec 和动态链接。
+-- 此模式下各练习的独立目标不再默认构建，但仍可单独构建运行。
+option("shared")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Build each exercise as a shared library for the fork server of the runner")
+option_end()
+
+if has_config("shared") then
+    set_default(false)
+
+    for _, dir in ipairs(os.dirs(path.join(os.scriptdir(), "[0-9][0-9]_*"))) do
+        local name = path.filename(dir)
+        target("exercise" .. name:sub(1, 2) .. "_shared")
+            set_default(true)
+            set_kind("shared")
+            add_defines("main=learn_exercise_main")
+            add_files(path.join(name, "main.cpp"), "shared/entry.cpp")
+        target_end()
+    end
+end
+
 -- 格式化输出
 target("exercise00")
     add_files("00_hello_world/main.cpp")
@@ -141,3 +204,10 @@ target("exercise33")
     add_files("33_std_accumulate/main.cpp")
 
 -- TODO: lambda; deque; forward_list; fs; thread; mutex;
+
+-- 基准测试：`xmake build bench && xmake run bench [filter...]`，
+-- 统计斐波那契、张量、映射和字符串练习中实现的耗时，应在 release 模式下运行。不默认构建
+target("bench")
+    set_default(false)
+    add_defines("EXERCISE_BENCHMARK")
+    add_files("bench/main.cpp")
@@ -0,0 +1,174 @@
+﻿#include "cache.h"
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+    // FNV-1a
+    struct Hasher {
+        std::uint64_t value = 0xcbf29ce484222325ull;
+
+        void update(const char *data, std::size_t len) {
+            for (auto i = 0u; i < len; ++i) {
+                value ^= static_cast<unsigned char>(data[i]);
+                value *= 0x100000001b3ull;
+            }
+        }
+        void update(std::string const &str) {
+            // 带上长度，避免相邻字段拼接产生歧义
+            auto len = str.size();
+            update(reinterpret_cast<const char *>(&len), sizeof(len));
+            update(str.data(), str.size());
+        }
+    };
+
+    std::string read_file(fs::path const &path) {
+        std::ifstream file(path, std::ios::binary);
+        return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    }
+
+    void hash_sources(Hasher &hasher, fs::path const &path, std::set<fs::path> &visited) {
+        std::error_code ec;
+        auto canonical = fs::weakly_canonical(path, ec);
+        if (ec || !visited.insert(canonical).second) {
+            return;
+        }
+        auto text = read_file(canonical);
+        hasher.update(canonical.filename().string());
+        hasher.update(text);
+
+        std::istringstream lines(text);
+        for (std::string line; std::getline(lines, line);) {
+            auto hash = line.find_first_not_of(" \t");
+            if (hash == std::string::npos || line[hash] != '#') {
+                continue;
+            }
+            auto directive = line.find_first_not_of(" \t", hash + 1);
+            if (directive == std::string::npos || line.compare(directive, 7, "include") != 0) {
+                continue;
+            }
+            auto begin = line.find('"', directive);
+            auto end = begin == std::string::npos ? begin : line.find('"', begin + 1);
+            if (end != std::string::npos) {
+                hash_sources(hasher, canonical.parent_path() / line.substr(begin + 1, end - begin - 1), visited);
+            }
+        }
+    }
+
+    // 在 PATH 中查找可执行文件，找不到时返回空路径
+    fs::path find_program(std::string const &name) {
+#if defined(_WIN32)
+        constexpr char SEPARATOR = ';';
+        std::string const suffixes[]{"", ".exe"};
+#else
+        constexpr char SEPARATOR = ':';
+        std::string const suffixes[]{""};
+#endif
+        auto path = std::getenv("PATH");
+        for (std::string dirs = path ? path : ""; !dirs.empty();) {
+            auto end = dirs.find(SEPARATOR);
+            fs::path dir = dirs.substr(0, end);
+            dirs = end == std::string::npos ? "" : dirs.substr(end + 1);
+            for (auto const &suffix : suffixes) {
+                std::error_code ec;
+                auto file = dir / (name + suffix);
+                if (fs::is_regular_file(file, ec)) {
+                    return file;
+                }
+            }
+        }
+        return {};
+    }
+
+    // xmake 可能选用的 C++ 编译器（`CXX` 的第一个词及常见的编译器名）解析符号链接后的路径、大小和修改时间。
+    // 升级编译器后即使 PATH 不变它也会改变。进程内只计算一次
+    std::string const &compiler_identity() {
+        static auto const ans = [] {
+            std::vector<std::string> names;
+            if (auto cxx = std::getenv("CXX")) {
+                std::istringstream(cxx) >> names.emplace_back();
+            }
+            for (auto name : {"c++", "g++", "clang++", "cl"}) {
+                names.emplace_back(name);
+            }
+            std::ostringstream os;
+            for (auto const &name : names) {
+                std::error_code ec;
+                auto program = name.find_first_of("/\\") == std::string::npos ? find_program(name) : fs::path(name);
+                auto canonical = program.empty() ? program : fs::canonical(program, ec);
+                if (program.empty() || ec) {
+                    continue;
+                }
+                auto size = fs::file_size(canonical, ec);
+                auto time = fs::last_write_time(canonical, ec).time_since_epoch().count();
+                os << canonical.string() << ' ' << size << ' ' << time << '\n';
+            }
+            return os.str();
+        }();
+        return ans;
+    }
+}// namespace
+
+std::uint64_t cache_key(fs::path const &exercises, fs::path const &main) {
+    Hasher hasher;
+    std::set<fs::path> visited;
+    hash_sources(hasher, main, visited);
+    // 合并编译时每个练习都经过预编译头
+    hash_sources(hasher, exercises / "pch.h", visited);
+    hasher.update(read_file(exercises / "xmake.lua"));
+
+    std::error_code ec;
+    std::set<fs::path> configs;
+    for (auto it = fs::recursive_directory_iterator(exercises / ".xmake", ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        if (it->path().filename() == "xmake.conf") {
+            configs.insert(it->path());
+        }
+    }
+    for (auto const &config : configs) {
+        hasher.update(read_file(config));
+    }
+
+    for (auto name : {"CC", "CXX", "CFLAGS", "CXXFLAGS", "LDFLAGS", "PATH"}) {
+        auto value = std::getenv(name);
+        hasher.update(value ? value : "");
+    }
+    hasher.update(compiler_identity());
+    return hasher.value;
+}
+
+bool cache_load(fs::path const &dir, const char *name, CacheEntry &entry) {
+    std::ifstream file(dir / name, std::ios::binary);
+    std::string key;
+    int pass;
+    if (!(file >> key >> pass) || file.get() != '\n') {
+        return false;
+    }
+    entry.key = std::strtoull(key.c_str(), nullptr, 16);
+    entry.pass = pass != 0;
+    entry.output.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+void cache_store(fs::path const &dir, const char *name, CacheEntry const &entry) {
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    // 先写临时文件再改名，并发的读者不会看到写了一半的缓存
+    auto path = dir / name, tmp = path;
+    tmp += ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        file << std::hex << std::setw(16) << std::setfill('0') << entry.key << ' '
+             << (entry.pass ? 1 : 0) << '\n'
+             << entry.output;
+        if (!file) {
+            return;
+        }
+    }
+    fs::rename(tmp, path, ec);
+}
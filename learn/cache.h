@@ -0,0 +1,25 @@
+﻿#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+struct CacheEntry {
+    std::uint64_t key;
+    bool pass;
+    std::string output;
+};
+
+// 练习的内容哈希，覆盖：
+// - `main`、合并编译共用的 pch.h 及它们以 `#include "..."` 递归引用的文件；
+// - 练习项目的 xmake.lua 和 .xmake 下记录工具链、编译模式及 `--unity`、`--shared`、`--audit` 等选项的 xmake.conf；
+// - 影响编译器选择和编译选项的环境变量；
+// - 可能被选用的编译器可执行文件的路径、大小和修改时间，升级编译器后缓存失效。
+std::uint64_t cache_key(std::filesystem::path const &exercises, std::filesystem::path const &main);
+
+// 缓存以练习名为文件名保存在 `dir` 下；文件不存在或损坏时 `cache_load` 返回假
+bool cache_load(std::filesystem::path const &dir, const char *name, CacheEntry &entry);
+void cache_store(std::filesystem::path const &dir, const char *name, CacheEntry const &entry);
+
+#endif// __CACHE_H__
@@ -0,0 +1,300 @@
+﻿#include "forkserver.h"
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+#if !defined(_WIN32)
+
+using Clock = std::chrono::steady_clock;
+using Entry = int (*)(int, char **);
+
+// 对端已退出时写入返回错误而不是触发 SIGPIPE
+#if defined(MSG_NOSIGNAL)
+constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+constexpr int SEND_FLAGS = 0;
+#endif
+
+// 运行器发给服务器的请求，需要捕获输出时随请求传递管道写端
+struct Request {
+    unsigned int exercise;
+    Limits limits;
+    bool counters;
+};
+
+struct Reply {
+    int code;
+    Usage usage;
+    Counters counters;
+};
+
+static bool send_request(int sock, Request const &request, int fd) {
+    iovec iov{const_cast<Request *>(&request), sizeof(request)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (fd >= 0) {
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        auto cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    }
+    ssize_t len;
+    while ((len = sendmsg(sock, &msg, SEND_FLAGS)) < 0 && errno == EINTR) {}
+    return len == sizeof(request);
+}
+
+static bool receive_request(int sock, Request &request, int &fd) {
+    iovec iov{&request, sizeof(request)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t len;
+    while ((len = recvmsg(sock, &msg, 0)) < 0 && errno == EINTR) {}
+    fd = -1;
+    auto cmsg = len > 0 ? CMSG_FIRSTHDR(&msg) : nullptr;
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+        std::memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    }
+    return len == sizeof(request);
+}
+
+static bool send_all(int sock, void const *data, size_t size) {
+    for (auto p = static_cast<char const *>(data); size > 0;) {
+        auto len = send(sock, p, size, SEND_FLAGS);
+        if (len < 0 && errno == EINTR) {
+            continue;
+        }
+        if (len <= 0) {
+            return false;
+        }
+        p += len;
+        size -= len;
+    }
+    return true;
+}
+
+static bool receive_all(int sock, void *data, size_t size) {
+    for (auto p = static_cast<char *>(data); size > 0;) {
+        auto len = recv(sock, p, size, 0);
+        if (len < 0 && errno == EINTR) {
+            continue;
+        }
+        if (len <= 0) {
+            return false;
+        }
+        p += len;
+        size -= len;
+    }
+    return true;
+}
+
+// 服务器主循环：预先加载所有练习，之后逐个处理请求，连接关闭时退出
+[[noreturn]] static void serve(int sock, std::map<unsigned int, fs::path> const &libraries) {
+    std::map<unsigned int, Entry> entries;
+    for (auto const &[n, path] : libraries) {
+        if (auto handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL)) {
+            if (auto entry = reinterpret_cast<Entry>(dlsym(handle, EXERCISE_ENTRY))) {
+                entries.emplace(n, entry);
+            }
+        }
+    }
+
+    for (;;) {
+        Request request;
+        int out;
+        if (!receive_request(sock, request, out)) {
+            _exit(EXIT_SUCCESS);
+        }
+        Reply reply{SPAWN_FAILED, {}, {}};
+        auto it = entries.find(request.exercise);
+        if (it != entries.end()) {
+            int gate[2]{-1, -1};
+            if (request.counters && perf_available() && !cloexec_pipe(gate)) {
+                gate[0] = gate[1] = -1;
+            }
+            auto start = Clock::now();
+            auto pid = fork();
+            if (pid == 0) {
+                close(sock);
+                child_setup(request.limits, out);
+                gate_pass(gate);
+                if (out >= 0) {
+                    close(out);
+                }
+                char name[] = "exerciseXX";
+                std::snprintf(name, sizeof(name), "exercise%02u", request.exercise % 100);
+                char *argv[]{name, nullptr};
+                // 经 `std::exit` 退出以刷新练习写入 std::cout 的缓冲
+                std::exit(it->second(1, argv));
+            }
+            PerfEvents events;
+            auto counting = false;
+            if (pid > 0) {
+                // 与子进程中的调用重复，避免在子进程执行到那里之前就需要杀死进程组
+                setpgid(pid, pid);
+                // 子进程不再 exec，计数器立即启用
+                counting = gate[0] >= 0 && perf_open(events, pid, false);
+            }
+            gate_release(gate);
+            if (out >= 0) {
+                close(out);
+            }
+            if (pid > 0) {
+                reply.code = child_wait(pid, start, request.limits, -1, nullptr, &reply.usage);
+            }
+            if (counting) {
+                reply.counters = perf_close(events);
+            }
+        } else if (out >= 0) {
+            close(out);
+        }
+        if (!send_all(sock, &reply, sizeof(reply))) {
+            _exit(EXIT_FAILURE);
+        }
+    }
+}
+
+#endif
+
+ForkServers::ForkServers(std::map<unsigned int, fs::path> libraries, unsigned int count)
+    : libraries(std::move(libraries)) {
+#if !defined(_WIN32)
+    if (this->libraries.empty()) {
+        return;
+    }
+    // 服务器及其子进程继承 stdio 缓冲，先清空以免重复输出
+    std::cout.flush();
+    std::fflush(nullptr);
+    for (auto i = 0u; i < count; ++i) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            break;
+        }
+        auto pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            for (auto sock : this->idle) {
+                close(sock);
+            }
+            serve(fds[1], this->libraries);
+        }
+        close(fds[1]);
+        if (pid < 0) {
+            close(fds[0]);
+            break;
+        }
+        fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+#if defined(SO_NOSIGPIPE)
+        int on = 1;
+        setsockopt(fds[0], SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+        this->pids.push_back(pid);
+        this->idle.push_back(fds[0]);
+    }
+    this->alive = static_cast<unsigned int>(this->idle.size());
+#endif
+}
+
+ForkServers::~ForkServers() {
+#if !defined(_WIN32)
+    for (auto sock : this->idle) {
+        close(sock);
+    }
+    for (auto pid : this->pids) {
+        while (waitpid(pid, nullptr, 0) < 0 && errno == EINTR) {}
+    }
+#endif
+}
+
+bool ForkServers::has(unsigned int n) const {
+    return !this->pids.empty() && this->libraries.count(n);
+}
+
+int ForkServers::run(unsigned int n, SpawnOptions const &options) {
+#if defined(_WIN32)
+    return SPAWN_FAILED;
+#else
+    if (!this->has(n)) {
+        return SPAWN_FAILED;
+    }
+    int sock;
+    {
+        std::unique_lock lock(this->mutex);
+        this->available.wait(lock, [this] { return !this->idle.empty() || this->alive == 0; });
+        if (this->idle.empty()) {
+            return SPAWN_FAILED;
+        }
+        sock = this->idle.back();
+        this->idle.pop_back();
+    }
+
+    // 归还连接；服务器已退出时关闭连接，不再使用
+    auto release = [&](bool alive) {
+        {
+            std::lock_guard lock(this->mutex);
+            if (alive) {
+                this->idle.push_back(sock);
+            } else {
+                close(sock);
+                --this->alive;
+            }
+        }
+        this->available.notify_all();
+    };
+
+    // 不捕获输出时子进程直接继承服务器的 stdout/stderr
+    int out[2]{-1, -1};
+    if (options.output && !cloexec_pipe(out)) {
+        release(true);
+        return SPAWN_FAILED;
+    }
+    auto ok = send_request(sock, {n, options.limits, options.counters != nullptr}, out[1]);
+    if (out[1] >= 0) {
+        close(out[1]);
+    }
+    // 写端只剩子进程持有，读到 EOF 即子进程已退出或服务器放弃了请求
+    if (out[0] >= 0) {
+        char buf[4096];
+        for (;;) {
+            auto len = read(out[0], buf, sizeof(buf));
+            if (len > 0) {
+                options.output->append(buf, len);
+            } else if (len == 0 || errno != EINTR) {
+                break;
+            }
+        }
+        close(out[0]);
+    }
+    Reply reply{SPAWN_FAILED, {}, {}};
+    ok = ok && receive_all(sock, &reply, sizeof(reply));
+    release(ok);
+    if (ok && reply.code != SPAWN_FAILED && options.usage) {
+        *options.usage += reply.usage;
+    }
+    if (ok && reply.code != SPAWN_FAILED && options.counters) {
+        *options.counters += reply.counters;
+    }
+    return reply.code;
+#endif
+}
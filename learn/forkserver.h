@@ -0,0 +1,42 @@
+﻿#ifndef __FORKSERVER_H__
+#define __FORKSERVER_H__
+
+#include "subprocess.h"
+#include <condition_variable>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <vector>
+
+// 以共享库形式构建的练习（`xmake f --shared=y`）导出的 C 入口，参数同 main
+constexpr auto EXERCISE_ENTRY = "learn_exercise_entry";
+
+// 常驻的 fork 服务器池。每个服务器进程启动时 dlopen 全部练习共享库，
+// 之后每个请求 fork 一个子进程调用练习入口，省去 exec 和动态链接的开销；
+// 练习中的 `exit(1)` 和崩溃都只影响该子进程。仅支持 POSIX，其他平台上不启动任何服务器。
+struct ForkServers {
+    // 启动 `count` 个服务器，预先加载 `libraries`（练习编号到共享库路径）。
+    // 服务器由当前进程 fork 而来，必须在创建任何线程之前构造
+    ForkServers(std::map<unsigned int, std::filesystem::path> libraries, unsigned int count);
+    ForkServers(ForkServers const &) = delete;
+    ForkServers &operator=(ForkServers const &) = delete;
+    // 关闭连接并等待所有服务器退出
+    ~ForkServers();
+
+    // 练习 n 是否有可用的共享库
+    bool has(unsigned int n) const;
+    // 在空闲的服务器上运行练习 n，返回值同 `process_spawn`；
+    // 服务器无法加载该练习或已退出时返回 `SPAWN_FAILED`，调用方应改用可执行文件运行
+    int run(unsigned int n, SpawnOptions const &options);
+
+private:
+    std::map<unsigned int, std::filesystem::path> libraries;
+    std::vector<int> pids;
+    // 空闲服务器的连接，`alive` 为仍可用的服务器数
+    std::vector<int> idle;
+    unsigned int alive = 0;
+    std::mutex mutex;
+    std::condition_variable available;
+};
+
+#endif// __FORKSERVER_H__
@@ -0,0 +1,156 @@
+﻿#include "history.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+bool history_append(fs::path const &path, std::vector<Sample> const &samples) {
+    std::error_code ec;
+    auto exists = fs::exists(path, ec);
+    fs::create_directories(path.parent_path(), ec);
+    std::ofstream file(path, std::ios::out | std::ios::app);
+    if (!exists) {
+        file << "run,kind,name,value" << std::endl;
+    }
+    file.precision(9);
+    for (auto const &sample : samples) {
+        file << sample.run << ',' << sample.kind << ',' << sample.name << ',' << sample.value << '\n';
+    }
+    file.flush();
+    return static_cast<bool>(file);
+}
+
+std::vector<Sample> history_load(fs::path const &path) {
+    std::vector<Sample> ans;
+    std::ifstream file(path);
+    std::string line;
+    // 跳过表头
+    std::getline(file, line);
+    while (std::getline(file, line)) {
+        // 名称中可能含逗号，取最后一个逗号后的值和前两个字段，中间都是名称
+        auto first = line.find(','), second = first == std::string::npos ? first : line.find(',', first + 1);
+        auto last = line.rfind(',');
+        if (second == std::string::npos || last <= second) {
+            continue;
+        }
+        Sample sample;
+        sample.run = line.substr(0, first);
+        sample.kind = line.substr(first + 1, second - first - 1);
+        sample.name = line.substr(second + 1, last - second - 1);
+        std::istringstream is(line.substr(last + 1));
+        if (is >> sample.value) {
+            ans.push_back(std::move(sample));
+        }
+    }
+    return ans;
+}
+
+std::string history_run_id() {
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    return std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
+}
+
+static double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    auto n = values.size();
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+// Mann–Whitney U 检验，返回双侧 p 值，`u` 为当前组 `a` 的 U 统计量
+static double mann_whitney(std::vector<double> const &a, std::vector<double> const &b, double &u) {
+    std::vector<std::pair<double, bool>> all;
+    for (auto x : a) {
+        all.emplace_back(x, true);
+    }
+    for (auto x : b) {
+        all.emplace_back(x, false);
+    }
+    std::sort(all.begin(), all.end(), [](auto const &x, auto const &y) { return x.first < y.first; });
+
+    // 并列的值取平均秩，同时累计并列校正项 Σ(t³ - t)
+    double rank_a = 0, ties = 0;
+    for (std::size_t i = 0; i < all.size();) {
+        auto j = i;
+        while (j < all.size() && all[j].first == all[i].first) {
+            ++j;
+        }
+        auto rank = (static_cast<double>(i + 1) + static_cast<double>(j)) / 2;
+        for (auto k = i; k < j; ++k) {
+            rank_a += all[k].second ? rank : 0;
+        }
+        auto t = static_cast<double>(j - i);
+        ties += t * t * t - t;
+        i = j;
+    }
+
+    auto n1 = static_cast<double>(a.size()), n2 = static_cast<double>(b.size()), n = n1 + n2;
+    u = rank_a - n1 * (n1 + 1) / 2;
+    auto mean = n1 * n2 / 2;
+    auto variance = n1 * n2 / 12 * ((n + 1) - ties / (n * (n - 1)));
+    if (variance <= 0) {
+        return 1;
+    }
+    auto z = (std::abs(u - mean) - 0.5) / std::sqrt(variance);
+    return std::min(1.0, std::erfc(std::max(z, 0.0) / std::sqrt(2.0)));
+}
+
+std::vector<Comparison> history_compare(std::vector<Sample> const &samples, CompareOptions const &options) {
+    // 每个序列的各次运行按首次出现的顺序排列
+    struct Series {
+        std::vector<std::string> runs;
+        std::map<std::string, std::vector<double>> values;
+    };
+    std::map<std::pair<std::string, std::string>, Series> series;
+    for (auto const &sample : samples) {
+        auto &s = series[{sample.kind, sample.name}];
+        auto &values = s.values[sample.run];
+        if (values.empty()) {
+            s.runs.push_back(sample.run);
+        }
+        values.push_back(sample.value);
+    }
+
+    std::vector<Comparison> ans;
+    for (auto const &[key, s] : series) {
+        // 没有在指定运行中出现的序列（如命中缓存未运行的练习）不再重复报告旧的结果
+        auto last = options.run.empty() ? s.runs.size() - 1
+                                        : static_cast<std::size_t>(std::find(s.runs.begin(), s.runs.end(), options.run) - s.runs.begin());
+        if (last == 0 || last >= s.runs.size()) {
+            continue;
+        }
+        auto const &current = s.values.at(s.runs[last]);
+        std::vector<double> baseline;
+        auto first = last > options.baseline_runs ? last - options.baseline_runs : 0;
+        for (auto i = first; i < last; ++i) {
+            auto const &values = s.values.at(s.runs[i]);
+            baseline.insert(baseline.end(), values.begin(), values.end());
+        }
+
+        Comparison c;
+        c.kind = key.first;
+        c.name = key.second;
+        c.baseline_count = baseline.size();
+        c.current_count = current.size();
+        c.baseline_median = median(baseline);
+        c.current_median = median(current);
+        c.change = c.baseline_median > 0 ? c.current_median / c.baseline_median - 1 : 0;
+        double u;
+        c.p_value = mann_whitney(current, baseline, u);
+        c.effect = 2 * u / (static_cast<double>(current.size()) * static_cast<double>(baseline.size())) - 1;
+        if (current.size() < MIN_COMPARE_SAMPLES || baseline.size() < MIN_COMPARE_SAMPLES) {
+            c.verdict = Verdict::Insufficient;
+        } else if (c.p_value < options.alpha && c.change > options.threshold) {
+            c.verdict = Verdict::Regression;
+        } else if (c.p_value < options.alpha && c.change < -options.threshold) {
+            c.verdict = Verdict::Improvement;
+        } else {
+            c.verdict = Verdict::Unchanged;
+        }
+        ans.push_back(std::move(c));
+    }
+    return ans;
+}
@@ -0,0 +1,64 @@
+﻿#ifndef __HISTORY_H__
+#define __HISTORY_H__
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// 历史文件中的一个耗时样本。`run` 标识产生它的一次运行，`kind` 与 `name` 确定一个序列，
+// 如练习的运行耗时（exercise, exerciseNN，单位秒）或基准测试用例（bench, 用例名，单位纳秒）
+struct Sample {
+    std::string run, kind, name;
+    double value;
+};
+
+// 以 CSV 追加到历史文件，文件不存在时先写表头
+bool history_append(std::filesystem::path const &path, std::vector<Sample> const &samples);
+// 按写入顺序读出所有样本，文件不存在时为空
+std::vector<Sample> history_load(std::filesystem::path const &path);
+// 新的运行标识：自 Unix 纪元以来的毫秒数
+std::string history_run_id();
+
+struct CompareOptions {
+    // 非空时只比较在这次运行中有样本的序列，以这次运行为当前组；
+    // 为空时比较所有序列，各以其最近一次运行为当前组。当前组与它之前的若干次运行合并的样本比较
+    std::string run;
+    unsigned int baseline_runs = 5;
+    // Mann–Whitney U 检验的显著性水平
+    double alpha = 0.01;
+    // 中位数相对变化超过该比例才视为回归或改进
+    double threshold = 0.05;
+};
+
+// 任一组少于该数目的样本时不作判断
+constexpr std::size_t MIN_COMPARE_SAMPLES = 3;
+// `summary --compare` 时每个练习至少运行的次数。当前组 3 个样本对 15 个基线样本时，
+// 只有当前组全部排在基线一侧才能在 alpha = 0.01 下显著（p ≈ 0.009），取 5 留出余量；
+// 基线同样要由这样的运行积累，5 个对 5 个样本在 alpha = 0.01 下不可能显著
+constexpr unsigned int COMPARE_REPEAT = 5;
+
+enum class Verdict {
+    // 任一组少于 `MIN_COMPARE_SAMPLES` 个样本，不作判断
+    Insufficient,
+    Unchanged,
+    Regression,
+    Improvement,
+};
+
+struct Comparison {
+    std::string kind, name;
+    std::size_t baseline_count, current_count;
+    double baseline_median, current_median;
+    // 中位数的相对变化，正数表示变慢
+    double change;
+    // 双侧 p 值（正态近似，含并列校正与连续性校正）
+    double p_value;
+    // Cliff's delta：当前组样本大于基线组样本的概率减去小于的概率，范围 [-1, 1]
+    double effect;
+    Verdict verdict;
+};
+
+// 对每个序列比较当前组与基线组，数值越大越差；结果按 `kind`、`name` 排序
+std::vector<Comparison> history_compare(std::vector<Sample> const &samples, CompareOptions const &options);
+
+#endif// __HISTORY_H__
@@ -1,15 +1,25 @@
 ﻿#include "test.h"
+#include "watch.h"
+#include <cstring>
 #include <iostream>
 
 int main(int argc, char **argv) {
     if (argc != 2) {
-        std::cerr << "Usage: xmake run learn <exercice number>" << std::endl;
+        std::cerr << "Usage: xmake run learn <exercice number>" << std::endl
+                  << "       xmake run learn --watch" << std::endl;
         return EXIT_FAILURE;
     }
+    if (std::strcmp(argv[1], "--watch") == 0) {
+        // 单独构建被修改的练习后直接执行构建产物，省去一次 xmake 启动
+        Log log{Console{}};
+        log.direct = true;
+        return watch(log);
+    }
     int num;
-    if (1 != std::sscanf(argv[1], "%d", &num)) {
+    if (1 != std::sscanf(argv[1], "%d", &num) || num < 0 || num > static_cast<int>(MAX_EXERCISE)) {
         std::cerr << "Invalid exercise number: " << argv[1] << std::endl;
-    };
+        return EXIT_FAILURE;
+    }
     Log{Console{}} << num;
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,130 @@
+﻿#include "perf.h"
+
+#if defined(__linux__)
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+bool Counters::has(Counter counter) const {
+    return this->available & (1u << counter);
+}
+
+double Counters::ipc() const {
+    if (!this->has(CYCLES) || !this->has(INSTRUCTIONS) || this->values[CYCLES] == 0) {
+        return -1;
+    }
+    return static_cast<double>(this->values[INSTRUCTIONS]) / static_cast<double>(this->values[CYCLES]);
+}
+
+double Counters::per_kilo_instruction(Counter counter) const {
+    if (!this->has(counter) || !this->has(INSTRUCTIONS) || this->values[INSTRUCTIONS] == 0) {
+        return -1;
+    }
+    return static_cast<double>(this->values[counter]) * 1000 / static_cast<double>(this->values[INSTRUCTIONS]);
+}
+
+Counters &Counters::operator+=(Counters const &others) {
+    // 只有两边都可用的事件才有意义
+    this->available = this->available ? this->available & others.available : others.available;
+    for (auto i = 0u; i < COUNTER_COUNT; ++i) {
+        this->values[i] += others.values[i];
+    }
+    return *this;
+}
+
+#if defined(__linux__)
+
+static perf_event_attr counter_attr(Counter counter) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    switch (counter) {
+        case CYCLES:
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case INSTRUCTIONS:
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case L1D_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_L1D |
+                          (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case LLC_MISSES:
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        case BRANCH_MISSES:
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        case COUNTER_COUNT:
+            break;
+    }
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.inherit = 1;
+    return attr;
+}
+
+bool perf_open(PerfEvents &events, int pid, bool on_exec) {
+    auto any = false;
+    for (auto i = 0u; i < COUNTER_COUNT; ++i) {
+        auto attr = counter_attr(static_cast<Counter>(i));
+        attr.disabled = on_exec;
+        attr.enable_on_exec = on_exec;
+        // perf_event_paranoid 过高、容器内没有 PMU 等情况下打开失败，该事件记为不可用
+        events.fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC));
+        any = any || events.fds[i] >= 0;
+    }
+    return any;
+}
+
+bool perf_available() {
+    static auto const ans = [] {
+        PerfEvents events;
+        auto any = perf_open(events, 0, false);
+        perf_close(events);
+        return any;
+    }();
+    return ans;
+}
+
+Counters perf_close(PerfEvents &events) {
+    Counters ans;
+    for (auto i = 0u; i < COUNTER_COUNT; ++i) {
+        auto &fd = events.fds[i];
+        if (fd < 0) {
+            continue;
+        }
+        std::uint64_t value[3];
+        if (read(fd, value, sizeof(value)) == sizeof(value) && value[2] > 0) {
+            ans.values[i] = value[2] < value[1]
+                                ? static_cast<std::uint64_t>(static_cast<double>(value[0]) * value[1] / value[2])
+                                : value[0];
+            ans.available |= 1u << i;
+        }
+        close(fd);
+        fd = -1;
+    }
+    return ans;
+}
+
+#else
+
+bool perf_available() {
+    return false;
+}
+
+bool perf_open(PerfEvents &, int, bool) {
+    return false;
+}
+
+Counters perf_close(PerfEvents &) {
+    return {};
+}
+
+#endif
@@ -0,0 +1,43 @@
+﻿#ifndef __PERF_H__
+#define __PERF_H__
+
+#include <cstdint>
+
+enum Counter : unsigned int {
+    CYCLES,
+    INSTRUCTIONS,
+    L1D_MISSES,
+    LLC_MISSES,
+    BRANCH_MISSES,
+    COUNTER_COUNT,
+};
+
+// 硬件性能计数器的读数（只统计用户态）。未能打开的事件不在 `available` 中置位，
+// 内核拒绝访问或不支持时 `available` 为 0
+struct Counters {
+    std::uint64_t values[COUNTER_COUNT]{};
+    unsigned int available = 0;
+
+    bool has(Counter counter) const;
+    // 每周期指令数；不可用时返回负数
+    double ipc() const;
+    // 每千条指令的事件数（如缓存或分支预测未命中）；不可用时返回负数
+    double per_kilo_instruction(Counter counter) const;
+    Counters &operator+=(Counters const &others);
+};
+
+// 附着到一个进程（含其之后创建的子进程）的一组计数器
+struct PerfEvents {
+    int fds[COUNTER_COUNT]{-1, -1, -1, -1, -1};
+};
+
+// 当前进程能否打开任一计数器，进程内只探测一次。
+// 不能时调用方不必为计数器在 fork 后暂停子进程
+bool perf_available();
+// 为进程 `pid` 打开计数器。`on_exec` 为真时计数从该进程下一次 exec 开始，否则立即开始。
+// 只在 Linux 上可用，没有任何事件能打开时返回假
+bool perf_open(PerfEvents &events, int pid, bool on_exec);
+// 读取计数（按多路复用的实际运行时间缩放）并关闭计数器
+Counters perf_close(PerfEvents &events);
+
+#endif// __PERF_H__
@@ -0,0 +1,58 @@
+﻿#include "pipeline.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+    struct Busy {
+        std::atomic<Clock::rep> ticks{0};
+        std::atomic_uint jobs{0};
+
+        template<class F>
+        auto measure(F &&f) {
+            auto start = Clock::now();
+            auto ans = f();
+            ticks += (Clock::now() - start).count();
+            ++jobs;
+            return ans;
+        }
+
+        StageStats stats(unsigned int workers) const {
+            return {workers, jobs.load(), std::chrono::duration<double>(Clock::duration(ticks.load())).count()};
+        }
+    };
+}// namespace
+
+PipelineStats run_pipeline(Log &log, std::vector<unsigned int> const &exercises, unsigned int jobs) {
+    if (jobs == 0) {
+        jobs = 1;
+    }
+
+    log.schedule(exercises);
+    auto start = Clock::now();
+    std::atomic_size_t next{0};
+    Busy build, run;
+
+    std::vector<std::thread> threads;
+    threads.reserve(jobs);
+    for (auto i = 0u; i < jobs; ++i) {
+        threads.emplace_back([&] {
+            for (auto k = next++; k < exercises.size(); k = next++) {
+                auto n = exercises[k];
+                auto built = build.measure([&] { return log.build(n); });
+                run.measure([&] { return &log.run(n, built); });
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    return {
+        std::chrono::duration<double>(Clock::now() - start).count(),
+        build.stats(jobs),
+        run.stats(jobs),
+    };
+}
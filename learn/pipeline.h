@@ -0,0 +1,24 @@
+﻿#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+
+#include "test.h"
+#include <vector>
+
+struct StageStats {
+    unsigned int workers;
+    unsigned int jobs;
+    // 所有工作线程累计的忙碌时间（秒）
+    double busy;
+};
+
+struct PipelineStats {
+    double wall;
+    StageStats build, run;
+};
+
+// `jobs` 个线程按给定顺序领取练习，各自先构建（或命中缓存）再运行，分别统计两个阶段的忙碌时间。
+// 逐个练习的 `xmake build` 争用 xmake 的项目锁，并不能同时编译，因此不另设构建线程池；
+// 需要并行编译时先以 `Log::build_all` 批量构建（`--direct`），由 xmake 在内部并行，这里只剩运行
+PipelineStats run_pipeline(Log &log, std::vector<unsigned int> const &exercises, unsigned int jobs);
+
+#endif// __PIPELINE_H__
@@ -0,0 +1,186 @@
+﻿#include "report.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+
+namespace fs = std::filesystem;
+
+// 计数器派生指标：IPC 及每千条指令的 L1D、LLC、分支预测未命中数，不可用时为负
+static double counter_metric(Counters const &counters, unsigned int i) {
+    switch (i) {
+        case 0:
+            return counters.ipc();
+        case 1:
+            return counters.per_kilo_instruction(L1D_MISSES);
+        case 2:
+            return counters.per_kilo_instruction(LLC_MISSES);
+        default:
+            return counters.per_kilo_instruction(BRANCH_MISSES);
+    }
+}
+
+constexpr const char *COUNTER_METRICS[]{"ipc", "l1d_mpki", "llc_mpki", "branch_mpki"};
+constexpr const char *COUNTER_NAMES[]{"cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"};
+
+static void write_csv(std::ostream &os, std::vector<Log::Record> const &records) {
+    os << "exercise,pass,cached,timeout,"
+          "build_wall,build_user,build_sys,build_peak_rss_kb,"
+          "run_wall,run_user,run_sys,run_peak_rss_kb";
+    for (auto name : COUNTER_NAMES) {
+        os << ",run_" << name;
+    }
+    for (auto name : COUNTER_METRICS) {
+        os << ",run_" << name;
+    }
+    os << std::endl;
+    // 不可用的计数器留空
+    for (auto const &r : records) {
+        os << r.exercise << ',' << r.pass << ',' << r.cached << ',' << r.timeout << ','
+           << r.build.wall << ',' << r.build.user << ',' << r.build.sys << ',' << r.build.peak_rss << ','
+           << r.run.wall << ',' << r.run.user << ',' << r.run.sys << ',' << r.run.peak_rss;
+        for (auto i = 0u; i < COUNTER_COUNT; ++i) {
+            os << ',';
+            if (r.counters.has(static_cast<Counter>(i))) {
+                os << r.counters.values[i];
+            }
+        }
+        for (auto i = 0u; i < std::size(COUNTER_METRICS); ++i) {
+            os << ',';
+            if (auto value = counter_metric(r.counters, i); value >= 0) {
+                os << value;
+            }
+        }
+        os << std::endl;
+    }
+}
+
+static void write_usage(std::ostream &os, const char *name, Usage const &usage) {
+    os << '"' << name << "\": {"
+       << "\"wall\": " << usage.wall << ", "
+       << "\"user\": " << usage.user << ", "
+       << "\"sys\": " << usage.sys << ", "
+       << "\"peak_rss_kb\": " << usage.peak_rss << '}';
+}
+
+// 不可用的计数器写为 null
+static void write_counters(std::ostream &os, Counters const &counters) {
+    os << "\"counters\": {";
+    for (auto i = 0u; i < COUNTER_COUNT; ++i) {
+        os << '"' << COUNTER_NAMES[i] << "\": ";
+        if (counters.has(static_cast<Counter>(i))) {
+            os << counters.values[i];
+        } else {
+            os << "null";
+        }
+        os << ", ";
+    }
+    for (auto i = 0u; i < std::size(COUNTER_METRICS); ++i) {
+        os << '"' << COUNTER_METRICS[i] << "\": ";
+        if (auto value = counter_metric(counters, i); value >= 0) {
+            os << value;
+        } else {
+            os << "null";
+        }
+        os << (i + 1 < std::size(COUNTER_METRICS) ? ", " : "}");
+    }
+}
+
+static void write_json(std::ostream &os, std::vector<Log::Record> const &records) {
+    os << '[' << std::endl;
+    for (auto i = 0u; i < records.size(); ++i) {
+        auto const &r = records[i];
+        os << "  {\"exercise\": " << r.exercise
+           << ", \"pass\": " << (r.pass ? "true" : "false")
+           << ", \"cached\": " << (r.cached ? "true" : "false")
+           << ", \"timeout\": " << (r.timeout ? "true" : "false") << ", ";
+        write_usage(os, "build", r.build);
+        os << ", ";
+        write_usage(os, "run", r.run);
+        os << ", ";
+        write_counters(os, r.counters);
+        os << '}' << (i + 1 < records.size() ? "," : "") << std::endl;
+    }
+    os << ']' << std::endl;
+}
+
+bool write_report(fs::path const &path, std::vector<Log::Record> records) {
+    std::sort(records.begin(), records.end(), [](auto const &a, auto const &b) { return a.exercise < b.exercise; });
+    std::ofstream file(path, std::ios::trunc);
+    file << std::fixed << std::setprecision(6);
+    if (path.extension() == ".json") {
+        write_json(file, records);
+    } else {
+        write_csv(file, records);
+    }
+    return static_cast<bool>(file);
+}
+
+bool read_report(fs::path const &path, std::vector<Log::Record> &records) {
+    std::ifstream file(path);
+    std::string line;
+    if (!std::getline(file, line)) {
+        return false;
+    }
+    auto split = [](std::string const &line) {
+        std::vector<std::string> ans;
+        std::istringstream is(line);
+        for (std::string cell; std::getline(is, cell, ',');) {
+            ans.push_back(cell);
+        }
+        if (!line.empty() && line.back() == ',') {
+            ans.emplace_back();
+        }
+        return ans;
+    };
+    std::map<std::string, std::size_t> columns;
+    auto header = split(line);
+    for (auto i = 0u; i < header.size(); ++i) {
+        columns.emplace(header[i], i);
+    }
+    if (!columns.count("exercise")) {
+        return false;
+    }
+
+    while (std::getline(file, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        auto cells = split(line);
+        auto cell = [&](std::string const &name) -> std::string const * {
+            auto it = columns.find(name);
+            return it != columns.end() && it->second < cells.size() && !cells[it->second].empty() ? &cells[it->second] : nullptr;
+        };
+        auto number = [&](std::string const &name, auto &value) {
+            if (auto text = cell(name)) {
+                std::istringstream(*text) >> value;
+                return true;
+            }
+            return false;
+        };
+        auto usage = [&](std::string const &stage, Usage &usage) {
+            number(stage + "_wall", usage.wall);
+            number(stage + "_user", usage.user);
+            number(stage + "_sys", usage.sys);
+            number(stage + "_peak_rss_kb", usage.peak_rss);
+        };
+
+        Log::Record r;
+        number("exercise", r.exercise);
+        number("pass", r.pass);
+        number("cached", r.cached);
+        number("timeout", r.timeout);
+        usage("build", r.build);
+        usage("run", r.run);
+        for (auto i = 0u; i < COUNTER_COUNT; ++i) {
+            if (number(std::string("run_") + COUNTER_NAMES[i], r.counters.values[i])) {
+                r.counters.available |= 1u << i;
+            }
+        }
+        records.push_back(r);
+    }
+    return true;
+}
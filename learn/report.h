@@ -0,0 +1,15 @@
+﻿#ifndef __REPORT_H__
+#define __REPORT_H__
+
+#include "test.h"
+#include <filesystem>
+#include <vector>
+
+// 按练习编号排序写出耗时报告；扩展名为 .json 时写 JSON，否则写 CSV
+bool write_report(std::filesystem::path const &path, std::vector<Log::Record> records);
+
+// 读取 `write_report` 写出的 CSV 报告并追加到 `records`。按表头识别各列，缺少的列取默认值；
+// 文件无法打开或没有 exercise 列时返回假
+bool read_report(std::filesystem::path const &path, std::vector<Log::Record> &records);
+
+#endif// __REPORT_H__
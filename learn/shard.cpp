@@ -0,0 +1,31 @@
+﻿#include "shard.h"
+#include "test.h"
+#include <algorithm>
+
+std::vector<unsigned int> shard_exercises(unsigned int index, unsigned int count, std::map<unsigned int, double> const &timings) {
+    auto known = 0.0;
+    for (auto const &[n, seconds] : timings) {
+        known += seconds;
+    }
+    auto fallback = timings.empty() ? 1.0 : known / static_cast<double>(timings.size());
+
+    std::vector<std::pair<double, unsigned int>> jobs;
+    for (auto i = 0u; i <= MAX_EXERCISE; ++i) {
+        auto it = timings.find(i);
+        jobs.emplace_back(it != timings.end() ? it->second : fallback, i);
+    }
+    // 耗时相同时按编号排序，保证划分是确定的
+    std::stable_sort(jobs.begin(), jobs.end(), [](auto const &a, auto const &b) { return a.first > b.first; });
+
+    std::vector<double> loads(count);
+    std::vector<unsigned int> ans;
+    for (auto const &[seconds, n] : jobs) {
+        auto shard = static_cast<unsigned int>(std::min_element(loads.begin(), loads.end()) - loads.begin());
+        loads[shard] += seconds;
+        if (shard == index) {
+            ans.push_back(n);
+        }
+    }
+    std::sort(ans.begin(), ans.end());
+    return ans;
+}
@@ -0,0 +1,13 @@
+﻿#ifndef __SHARD_H__
+#define __SHARD_H__
+
+#include <map>
+#include <vector>
+
+// 分片 `index`（从 0 开始，共 `count` 片）负责的练习，按编号升序排列。
+// `timings` 为各练习历史上的构建加运行耗时（秒）：按耗时从长到短依次分给当前总耗时最短的分片，
+// 没有记录的练习按已有记录的平均值估计，全都没有时等价于轮流分配。
+// 相同的输入在任何机器上得到相同的划分，各分片的并集恰好是所有练习。
+std::vector<unsigned int> shard_exercises(unsigned int index, unsigned int count, std::map<unsigned int, double> const &timings);
+
+#endif// __SHARD_H__
@@ -0,0 +1,60 @@
+﻿// 运行器自身的测试：多个线程同时带计数器启动子进程，不能互相卡住。
+// 用法：xmake run spawn_test [线程数] [每个线程的启动次数]
+
+#include "subprocess.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+int main(int argc, char **argv) {
+#if defined(_WIN32)
+    std::cout << "spawn_test: skipped on Windows" << std::endl;
+    return EXIT_SUCCESS;
+#else
+    auto threads = argc > 1 ? std::stoul(argv[1]) : 8ul;
+    auto spawns = argc > 2 ? std::stoul(argv[2]) : 200ul;
+
+    std::atomic_ulong done{0}, failed{0};
+    std::atomic_bool finished{false};
+    // 卡死时没有子进程会返回，由看门狗判定失败
+    std::thread watchdog([&] {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+        while (!finished) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                std::cerr << "spawn_test: stuck after " << done << " of " << threads * spawns << " spawns" << std::endl;
+                std::_Exit(EXIT_FAILURE);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    });
+
+    std::vector<std::thread> workers;
+    for (auto i = 0ul; i < threads; ++i) {
+        workers.emplace_back([&] {
+            for (auto j = 0ul; j < spawns; ++j) {
+                Counters counters;
+                SpawnOptions options;
+                options.limits = {10, 0};
+                options.counters = &counters;
+                if (process_spawn({"true"}, options) != 0) {
+                    ++failed;
+                }
+                ++done;
+            }
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    finished = true;
+    watchdog.join();
+
+    std::cout << "spawn_test: " << done << " spawns, " << failed << " failed, counters "
+              << (perf_available() ? "available" : "unavailable") << std::endl;
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+#endif
+}
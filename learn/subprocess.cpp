@@ -0,0 +1,405 @@
+﻿#include "subprocess.h"
+#include <algorithm>
+#include <chrono>
+
+#if defined(_WIN32)
+#include <atomic>
+#include <thread>
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <poll.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+extern char **environ;
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+Usage &Usage::operator+=(Usage const &others) {
+    wall += others.wall;
+    user += others.user;
+    sys += others.sys;
+    peak_rss = std::max(peak_rss, others.peak_rss);
+    return *this;
+}
+
+#if defined(_WIN32)
+
+// 按 CommandLineToArgvW 的规则给参数加引号：反斜杠只在紧邻引号时需要转义
+static void append_quoted(std::wstring &cmd, std::string const &arg) {
+    std::wstring wide;
+    if (!arg.empty()) {
+        auto len = MultiByteToWideChar(CP_ACP, 0, arg.data(), static_cast<int>(arg.size()), nullptr, 0);
+        wide.resize(len);
+        MultiByteToWideChar(CP_ACP, 0, arg.data(), static_cast<int>(arg.size()), wide.data(), len);
+    }
+    if (!cmd.empty()) {
+        cmd += L' ';
+    }
+    cmd += L'"';
+    size_t backslashes = 0;
+    for (auto c : wide) {
+        if (c == L'\\') {
+            ++backslashes;
+            continue;
+        }
+        cmd.append(c == L'"' ? backslashes * 2 + 1 : backslashes, L'\\');
+        cmd += c;
+        backslashes = 0;
+    }
+    cmd.append(backslashes * 2, L'\\');
+    cmd += L'"';
+}
+
+// 复制出一个可继承的句柄，失败时返回空
+static HANDLE inheritable(HANDLE handle) {
+    HANDLE dup = nullptr;
+    if (handle && handle != INVALID_HANDLE_VALUE) {
+        DuplicateHandle(GetCurrentProcess(), handle, GetCurrentProcess(), &dup, 0, TRUE, DUPLICATE_SAME_ACCESS);
+    }
+    return dup;
+}
+
+int process_spawn(std::vector<std::string> const &argv, SpawnOptions const &options) {
+    std::wstring cmd;
+    for (auto const &arg : argv) {
+        append_quoted(cmd, arg);
+    }
+
+    // 子进程的标准句柄经 STARTUPINFO 传入，不改动当前进程的 stdout/stderr。
+    // 可继承的句柄只通过 PROC_THREAD_ATTRIBUTE_HANDLE_LIST 交给这一个子进程，
+    // 其他线程同时启动的子进程不会拿到管道写端，读端因此能按时读到 EOF
+    HANDLE read = nullptr, write = nullptr;
+    if (options.output) {
+        SECURITY_ATTRIBUTES sa{sizeof(sa), nullptr, TRUE};
+        if (!CreatePipe(&read, &write, &sa, 0)) {
+            return SPAWN_FAILED;
+        }
+        SetHandleInformation(read, HANDLE_FLAG_INHERIT, 0);
+    }
+    STARTUPINFOEXW si{};
+    si.StartupInfo.cb = sizeof(si);
+    si.StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+    si.StartupInfo.hStdInput = inheritable(GetStdHandle(STD_INPUT_HANDLE));
+    si.StartupInfo.hStdOutput = write ? write : inheritable(GetStdHandle(STD_OUTPUT_HANDLE));
+    si.StartupInfo.hStdError = write ? write : inheritable(GetStdHandle(STD_ERROR_HANDLE));
+
+    std::vector<HANDLE> handles;
+    for (auto handle : {si.StartupInfo.hStdInput, si.StartupInfo.hStdOutput, si.StartupInfo.hStdError}) {
+        if (handle && std::find(handles.begin(), handles.end(), handle) == handles.end()) {
+            handles.push_back(handle);
+        }
+    }
+    SIZE_T size = 0;
+    InitializeProcThreadAttributeList(nullptr, 1, 0, &size);
+    std::vector<char> attributes(size);
+    si.lpAttributeList = reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(attributes.data());
+    auto ready = InitializeProcThreadAttributeList(si.lpAttributeList, 1, 0, &size) &&
+                 (handles.empty() ||
+                  UpdateProcThreadAttribute(si.lpAttributeList, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST,
+                                            handles.data(), handles.size() * sizeof(HANDLE), nullptr, nullptr));
+
+    auto start = Clock::now();
+    PROCESS_INFORMATION pi{};
+    auto spawned = ready &&
+                   CreateProcessW(nullptr, cmd.data(), nullptr, nullptr, !handles.empty(),
+                                  EXTENDED_STARTUPINFO_PRESENT, nullptr, nullptr, &si.StartupInfo, &pi);
+    if (ready) {
+        DeleteProcThreadAttributeList(si.lpAttributeList);
+    }
+    // 子进程已持有自己的副本，父进程中的写端必须关闭，否则读不到 EOF
+    for (auto handle : handles) {
+        CloseHandle(handle);
+    }
+    if (spawned) {
+        CloseHandle(pi.hThread);
+    }
+
+    // 看门狗只能终止子进程本身，内存上限未实现
+    std::atomic_bool timeout{false};
+    std::thread watchdog;
+    if (spawned && options.limits.timeout > 0) {
+        watchdog = std::thread([&] {
+            auto ms = static_cast<DWORD>(options.limits.timeout * 1000);
+            if (WaitForSingleObject(pi.hProcess, ms) == WAIT_TIMEOUT) {
+                timeout = true;
+                TerminateProcess(pi.hProcess, 1);
+            }
+        });
+    }
+    if (read) {
+        if (spawned) {
+            char buf[4096];
+            for (DWORD len; ReadFile(read, buf, sizeof(buf), &len, nullptr) && len > 0;) {
+                options.output->append(buf, len);
+            }
+        }
+        CloseHandle(read);
+    }
+    int code = SPAWN_FAILED;
+    if (spawned) {
+        DWORD exit_code;
+        if (WaitForSingleObject(pi.hProcess, INFINITE) == WAIT_OBJECT_0 && GetExitCodeProcess(pi.hProcess, &exit_code)) {
+            code = static_cast<int>(exit_code);
+        }
+    }
+    if (watchdog.joinable()) {
+        watchdog.join();
+    }
+    if (spawned) {
+        CloseHandle(pi.hProcess);
+    }
+    if (options.usage) {
+        // Windows 上只统计墙钟时间
+        options.usage->wall += std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    return timeout ? SPAWN_TIMEOUT : code;
+}
+
+#else
+
+// 在父进程中按 PATH 查找可执行文件，fork 之后的子进程中只做异步信号安全的调用
+static std::string resolve(std::string const &name) {
+    if (name.find('/') != std::string::npos) {
+        return name;
+    }
+    auto path = std::getenv("PATH");
+    for (std::string dirs = path ? path : "/usr/bin:/bin"; !dirs.empty();) {
+        auto end = dirs.find(':');
+        auto dir = dirs.substr(0, end);
+        dirs = end == std::string::npos ? "" : dirs.substr(end + 1);
+        auto file = (dir.empty() ? "." : dir) + '/' + name;
+        if (access(file.c_str(), X_OK) == 0) {
+            return file;
+        }
+    }
+    return name;
+}
+
+bool cloexec_pipe(int fds[2]) {
+    // 其他线程可能同时启动子进程，管道两端都不能被它们继承
+#if defined(__linux__)
+    return ::pipe2(fds, O_CLOEXEC) == 0;
+#else
+    if (::pipe(fds) != 0) {
+        return false;
+    }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+#endif
+}
+
+void child_setup(Limits const &limits, int out) {
+    setpgid(0, 0);
+    if (limits.timeout > 0) {
+        rlim_t cpu = static_cast<rlim_t>(limits.timeout) + 1;
+        rlimit limit{cpu, cpu};
+        setrlimit(RLIMIT_CPU, &limit);
+    }
+    if (limits.memory > 0) {
+        rlim_t bytes = static_cast<rlim_t>(limits.memory) << 20;
+        rlimit limit{bytes, bytes};
+        setrlimit(RLIMIT_AS, &limit);
+    }
+    if (out >= 0) {
+        dup2(out, STDOUT_FILENO);
+        dup2(out, STDERR_FILENO);
+    }
+}
+
+void gate_pass(int gate[2]) {
+    if (gate[0] < 0) {
+        return;
+    }
+    close(gate[1]);
+    char c;
+    while (read(gate[0], &c, 1) < 0 && errno == EINTR) {}
+    close(gate[0]);
+}
+
+void gate_release(int gate[2]) {
+    for (auto i = 0; i < 2; ++i) {
+        if (gate[i] >= 0) {
+            close(gate[i]);
+            gate[i] = -1;
+        }
+    }
+}
+
+int child_wait(int pid, Clock::time_point start, Limits const &limits, int out, std::string *output, Usage *usage) {
+    auto const timeout = limits.timeout;
+    auto deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(timeout));
+    auto timed_out = false;
+    // 超过期限时杀死整个进程组，返回真表示已经超时
+    auto check_deadline = [&] {
+        if (!timed_out && timeout > 0 && Clock::now() >= deadline) {
+            kill(-pid, SIGKILL);
+            timed_out = true;
+        }
+        return timed_out;
+    };
+
+    if (out >= 0) {
+        char buf[4096];
+        for (;;) {
+            auto wait_ms = -1;
+            if (timeout > 0 && !timed_out) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+                wait_ms = static_cast<int>(std::max<long long>(left, 0) + 1);
+            }
+            pollfd fd{out, POLLIN, 0};
+            auto ready = poll(&fd, 1, wait_ms);
+            if (ready < 0 && errno != EINTR) {
+                break;
+            }
+            if (ready <= 0) {
+                check_deadline();
+                continue;
+            }
+            auto len = read(out, buf, sizeof(buf));
+            if (len > 0) {
+                output->append(buf, len);
+            } else if (len == 0 || errno != EINTR) {
+                break;
+            }
+        }
+        close(out);
+    }
+
+    int status;
+    rusage ru;
+    for (auto sleep = std::chrono::milliseconds(1);;) {
+        auto ans = wait4(pid, &status, timeout > 0 && !timed_out ? WNOHANG : 0, &ru);
+        if (ans == pid) {
+            break;
+        }
+        if (ans < 0 && errno != EINTR) {
+            return SPAWN_FAILED;
+        }
+        if (ans == 0 && !check_deadline()) {
+            std::this_thread::sleep_for(sleep);
+            sleep = std::min(sleep * 2, std::chrono::milliseconds(20));
+        }
+    }
+    if (usage) {
+        auto seconds = [](timeval const &tv) { return tv.tv_sec + tv.tv_usec / 1e6; };
+#if defined(__APPLE__)
+        auto peak_rss = static_cast<long>(ru.ru_maxrss / 1024);
+#else
+        auto peak_rss = static_cast<long>(ru.ru_maxrss);
+#endif
+        *usage += {
+            std::chrono::duration<double>(Clock::now() - start).count(),
+            seconds(ru.ru_utime),
+            seconds(ru.ru_stime),
+            peak_rss,
+        };
+    }
+    if (timed_out) {
+        return SPAWN_TIMEOUT;
+    }
+    // 超出 CPU 时间上限的子进程收到 SIGXCPU，同样视为超时
+    if (WIFSIGNALED(status) && WTERMSIG(status) == SIGXCPU) {
+        return SPAWN_TIMEOUT;
+    }
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    }
+    if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    }
+    return SPAWN_FAILED;
+}
+
+static std::mutex gate_mutex;
+
+int process_spawn(std::vector<std::string> const &argv, SpawnOptions const &options) {
+    auto path = resolve(argv[0]);
+    std::vector<char *> args;
+    args.reserve(argv.size() + 1);
+    for (auto const &arg : argv) {
+        args.push_back(const_cast<char *>(arg.c_str()));
+    }
+    args.push_back(nullptr);
+
+    // 闸门的写端会被其他线程同时 fork 的子进程继承，它们 exec 之前闸门都不会打开；
+    // 若那些子进程也在等自己的闸门就会互相卡死，因此同一时刻只允许一个闸门存在。
+    // 内核不允许打开计数器时不建闸门
+    auto const gated = options.counters && perf_available();
+    std::unique_lock<std::mutex> lock(gate_mutex, std::defer_lock);
+    if (gated) {
+        lock.lock();
+    }
+
+    // `err` 在 exec 成功时随之关闭，失败时子进程通过它回传 errno
+    int out[2]{-1, -1}, err[2], gate[2]{-1, -1};
+    if (!cloexec_pipe(err)) {
+        return SPAWN_FAILED;
+    }
+    if (options.output && !cloexec_pipe(out)) {
+        close(err[0]);
+        close(err[1]);
+        return SPAWN_FAILED;
+    }
+    // 无法创建闸门时照常运行，只是没有计数器读数
+    if (gated && !cloexec_pipe(gate)) {
+        gate[0] = gate[1] = -1;
+    }
+
+    auto start = Clock::now();
+    auto pid = fork();
+    if (pid == 0) {
+        child_setup(options.limits, out[1]);
+        gate_pass(gate);
+        execve(path.c_str(), args.data(), environ);
+        auto code = errno;
+        while (write(err[1], &code, sizeof(code)) < 0 && errno == EINTR) {}
+        _exit(127);
+    }
+    close(err[1]);
+    if (out[1] >= 0) {
+        close(out[1]);
+    }
+    if (pid < 0) {
+        close(err[0]);
+        if (out[0] >= 0) {
+            close(out[0]);
+        }
+        gate_release(gate);
+        return SPAWN_FAILED;
+    }
+    // 与子进程中的调用重复，避免在子进程执行到那里之前就需要杀死进程组
+    setpgid(pid, pid);
+    // 计数器在 exec 时启用，只统计目标程序本身
+    PerfEvents events;
+    auto counting = gate[0] >= 0 && perf_open(events, pid, true);
+    gate_release(gate);
+    if (lock.owns_lock()) {
+        lock.unlock();
+    }
+    int exec_errno;
+    ssize_t len;
+    while ((len = read(err[0], &exec_errno, sizeof(exec_errno))) < 0 && errno == EINTR) {}
+    close(err[0]);
+    auto failed = len > 0;
+
+    auto code = child_wait(pid, start, options.limits, out[0], options.output, failed ? nullptr : options.usage);
+    if (counting) {
+        auto counters = perf_close(events);
+        if (!failed) {
+            *options.counters += counters;
+        }
+    }
+    return failed ? SPAWN_FAILED : code;
+}
+
+#endif
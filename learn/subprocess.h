@@ -0,0 +1,65 @@
+﻿#ifndef __SUBPROCESS_H__
+#define __SUBPROCESS_H__
+
+#include "perf.h"
+#include <chrono>
+#include <string>
+#include <vector>
+
+// 子进程的资源占用，CPU 时间和内存峰值包含它等待过的后代进程（如 xmake 启动的编译器）
+struct Usage {
+    // 秒
+    double wall = 0, user = 0, sys = 0;
+    // KiB
+    long peak_rss = 0;
+
+    Usage &operator+=(Usage const &others);
+};
+
+// 子进程的资源限制，0 表示不限制
+struct Limits {
+    // 墙钟时间（秒），超时后杀死子进程所在的整个进程组；同时作为 CPU 时间上限
+    double timeout = 0;
+    // 虚拟内存上限（MiB）
+    unsigned long memory = 0;
+};
+
+struct SpawnOptions {
+    // 非空时子进程的 stdout/stderr 经管道捕获并追加到 `output`，否则继承当前进程的输出
+    std::string *output = nullptr;
+    // 非空时累加子进程的资源占用
+    Usage *usage = nullptr;
+    Limits limits;
+    // 非空时累加子进程 exec 之后的硬件性能计数器读数（仅 Linux）
+    Counters *counters = nullptr;
+};
+
+// `process_spawn` 除退出码外的返回值
+constexpr int SPAWN_FAILED = -1;
+constexpr int SPAWN_TIMEOUT = -2;
+
+// 不经过 shell 直接启动 `argv[0]`（按 PATH 查找）并等待其退出。
+// 返回子进程退出码；被信号终止时返回 128 + 信号值；
+// 无法启动时返回 `SPAWN_FAILED`，超时被杀死时返回 `SPAWN_TIMEOUT`。
+int process_spawn(std::vector<std::string> const &argv, SpawnOptions const &options);
+
+#if !defined(_WIN32)
+
+// 以下供 fork 之后不 exec 的调用方复用
+
+// 创建两端都带 FD_CLOEXEC 的管道
+bool cloexec_pipe(int fds[2]);
+// fork 之后在子进程中调用：进入独立的进程组，按 `limits` 设置 rlimit，`out` 非负时重定向 stdout/stderr
+void child_setup(Limits const &limits, int out);
+// 闸门管道：子进程 fork 后在 `gate_pass` 中等待，直到父进程为它打开计数器后调用 `gate_release`。
+// 未创建管道（两端为 -1）时两者都不做任何事。其他线程同时 fork 的子进程会继承闸门的写端，
+// 多线程的调用方须保证同一时刻只有一个闸门，否则互相等待的子进程会永远卡住
+void gate_pass(int gate[2]);
+void gate_release(int gate[2]);
+// 在父进程中调用：`out` 非负时读取它直至 EOF 并关闭，然后等待子进程退出，超过期限时杀死其进程组。
+// 返回值同 `process_spawn`
+int child_wait(int pid, std::chrono::steady_clock::time_point start, Limits const &limits, int out, std::string *output, Usage *usage);
+
+#endif
+
+#endif// __SUBPROCESS_H__
@@ -1,58 +1,446 @@
-﻿#include "test.h"
+﻿#include "forkserver.h"
+#include "history.h"
+#include "pipeline.h"
+#include "report.h"
+#include "shard.h"
+#include "test.h"
 #include <atomic>
 #include <chrono>
+#include <cstdio>
 #include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <numeric>
 #include <sstream>
 #include <thread>
 #include <vector>
 
-constexpr auto MAX_EXERCISE = 33;
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
-int main(int argc, char **argv) {
-    if (argc == 1) {
-        Log log{Console{}};
-        for (auto i = 0; i <= MAX_EXERCISE; ++i) {
-            log << i;
+static bool is_terminal() {
+#if defined(_WIN32)
+    return _isatty(_fileno(stdout));
+#else
+    return isatty(STDOUT_FILENO);
+#endif
+}
+
+static void print_results(Log const &log) {
+    std::cout << '[';
+    for (auto i = 0u; i <= MAX_EXERCISE; ++i) {
+        switch (log.status(i)) {
+            case Status::Pending:
+                std::cout << '.';
+                break;
+            case Status::Pass:
+            case Status::Cached:
+                std::cout << "\x1b[32m#\x1b[0m";
+                break;
+            case Status::Fail:
+                std::cout << "\x1b[31mX\x1b[0m";
+                break;
+            case Status::Timeout:
+                std::cout << "\x1b[31mT\x1b[0m";
+                break;
+        }
+    }
+    std::cout << ']';
+}
+
+static void print_elapsed(std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "elapsed: " << std::fixed << std::setprecision(2) << elapsed.count() << 's' << std::endl;
+}
+
+static void print_stage(const char *name, StageStats const &stage, double wall) {
+    auto utilization = wall > 0 ? stage.busy / (wall * stage.workers) * 100 : 0;
+    std::cout << name << ": " << stage.workers << " worker(s), " << stage.jobs << " job(s), busy "
+              << std::fixed << std::setprecision(2) << stage.busy << "s, utilization "
+              << std::setprecision(1) << utilization << '%' << std::endl;
+}
+
+// 所有练习运行阶段计数器的合计
+static void print_counters(Log const &log) {
+    if (!log.counters) {
+        return;
+    }
+    Counters total;
+    for (auto const &record : log.records()) {
+        if (record.counters.available) {
+            total += record.counters;
+        }
+    }
+    if (!total.available) {
+        std::cout << "counters: unavailable (perf_event_open denied or unsupported, or no exercise ran directly)" << std::endl;
+        return;
+    }
+    std::cout << "counters: " << std::fixed << std::setprecision(2);
+    auto print = [&](const char *name, double value) {
+        std::cout << name << ' ';
+        if (value >= 0) {
+            std::cout << value;
+        } else {
+            std::cout << '-';
+        }
+    };
+    print("IPC", total.ipc());
+    print(", L1D MPKI", total.per_kilo_instruction(L1D_MISSES));
+    print(", LLC MPKI", total.per_kilo_instruction(LLC_MISSES));
+    print(", branch MPKI", total.per_kilo_instruction(BRANCH_MISSES));
+    std::cout << std::endl;
+}
+
+// 报告的相对路径相对于 log 目录
+static void save_report(std::filesystem::path const &path, Log const &log) {
+    if (path.empty()) {
+        return;
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    if (write_report(path, log.records())) {
+        std::cout << "report: " << path.string() << std::endl;
+    } else {
+        std::cerr << "Failed to write report: " << path.string() << std::endl;
+    }
+}
+
+// 以 `count` 个 fork 服务器预先加载所有已构建的练习共享库，须在创建线程之前调用
+static std::unique_ptr<ForkServers> start_fork_servers(Log &log, unsigned int count) {
+    std::map<unsigned int, std::filesystem::path> libraries;
+    for (auto i = 0u; i <= MAX_EXERCISE; ++i) {
+        auto library = exercise_library(i);
+        if (!library.empty()) {
+            libraries.emplace(i, std::move(library));
         }
-        std::cout << std::accumulate(log.result.begin(), log.result.end(), 0, std::plus{}) << '/' << MAX_EXERCISE + 1 << " [";
-        for (auto b : log.result) {
-            std::cout << (b ? "\x1b[32m#\x1b[0m" : "\x1b[31mX\x1b[0m");
+    }
+    std::cout << "fork server: " << libraries.size() << " shared exercise(s)" << std::endl;
+    auto servers = std::make_unique<ForkServers>(std::move(libraries), count);
+    log.fork_servers = servers.get();
+    return servers;
+}
+
+// 历史耗时：记录中每个练习构建加运行的墙钟时间，命中缓存的记录不能代表实际耗时，不计入
+static std::map<unsigned int, double> load_timings(std::filesystem::path const &path) {
+    std::vector<Log::Record> records;
+    std::map<unsigned int, double> ans;
+    if (read_report(path, records)) {
+        for (auto const &record : records) {
+            if (!record.cached && record.exercise <= MAX_EXERCISE) {
+                ans[record.exercise] = record.build.wall + record.run.wall;
+            }
         }
-        std::cout << ']' << std::endl;
-        return EXIT_SUCCESS;
     }
-    if (argc == 2 && std::strcmp(argv[1], "--simple") == 0) {
-        auto concurrency = std::thread::hardware_concurrency();
-        if (concurrency == 0) {
-            concurrency = 1;
+    return ans;
+}
+
+// 用本次结果中实际构建运行过的练习更新历史耗时，其余练习保留原有记录
+static void update_timings(std::filesystem::path const &path, Log const &log) {
+    std::vector<Log::Record> old;
+    read_report(path, old);
+    std::map<unsigned int, Log::Record> records;
+    for (auto const &record : old) {
+        if (record.exercise <= MAX_EXERCISE) {
+            records[record.exercise] = record;
         }
+    }
+    for (auto const &record : log.records()) {
+        if (!record.cached) {
+            records[record.exercise] = record;
+        }
+    }
+    std::vector<Log::Record> ans;
+    for (auto const &[n, record] : records) {
+        ans.push_back(record);
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    write_report(path, ans);
+}
+
+// 合并各分片的 CSV 报告：同一练习出现多次时以后出现的为准
+static int merge_reports(std::vector<std::filesystem::path> const &files, std::filesystem::path const &report, std::filesystem::path const &timings) {
+    Log log{Null{}};
+    for (auto const &file : files) {
+        std::vector<Log::Record> records;
+        if (!read_report(file, records)) {
+            std::cerr << "Failed to read report: " << file.string() << std::endl;
+            return EXIT_FAILURE;
+        }
+        for (auto const &record : records) {
+            if (record.exercise <= MAX_EXERCISE) {
+                log.restore(record);
+                log.counters = log.counters || record.counters.available;
+            }
+        }
+    }
+    std::cout << log.passed() << '/' << MAX_EXERCISE + 1 << ' ';
+    print_results(log);
+    std::cout << std::endl;
+    if (auto finished = log.finished(); finished <= MAX_EXERCISE) {
+        std::cout << "missing: " << MAX_EXERCISE + 1 - finished << " exercise(s) not found in any shard" << std::endl;
+    }
+    print_counters(log);
+    save_report(report, log);
+    update_timings(timings, log);
+    return EXIT_SUCCESS;
+}
 
-        std::atomic_int k{0};
-        std::vector<std::thread> threads;
-        threads.reserve(concurrency);
+// 检测到回归时 summary 的退出码
+constexpr int EXIT_REGRESSION = 3;
 
-        std::cout << "concurrency: " << concurrency << std::endl;
-        Log log{Null{}};
-        for (auto i = 0u; i <= concurrency; ++i) {
-            threads.emplace_back([i, &log, &k] {
-                int j = k.fetch_add(1);
-                while (j <= MAX_EXERCISE) {
-                    std::printf("run %d at %d\n", j, i);
-                    log << j;
-                    j = k.fetch_add(1);
-                }
-            });
+// 把本次实际运行并通过的练习的耗时样本追加到历史文件，失败和超时的运行不进入基线；返回本次运行的标识
+static std::string append_history(std::filesystem::path const &path, Log const &log) {
+    auto run = history_run_id();
+    std::vector<Sample> samples;
+    for (auto const &record : log.records()) {
+        if (record.cached || !record.pass) {
+            continue;
         }
-        for (auto &thread : threads) {
-            thread.join();
+        char name[] = "exerciseXX";
+        std::sprintf(name, "exercise%02u", record.exercise);
+        for (auto value : record.samples) {
+            samples.push_back({run, "exercise", name, value});
         }
+    }
+    if (!samples.empty() && !history_append(path, samples)) {
+        std::cerr << "Failed to append history: " << path.string() << std::endl;
+    }
+    return run;
+}
+
+// 比较历史文件中的序列与基线（`options.run` 非空时只比较这次运行的序列），列出回归和改进，有回归时返回 `EXIT_REGRESSION`
+static int compare_history(std::filesystem::path const &path, CompareOptions const &options) {
+    auto comparisons = history_compare(history_load(path), options);
+    auto regressions = 0u, improvements = 0u, insufficient = 0u;
+    for (auto const &c : comparisons) {
+        if (c.verdict == Verdict::Insufficient) {
+            ++insufficient;
+            continue;
+        }
+        if (c.verdict == Verdict::Unchanged) {
+            continue;
+        }
+        auto regression = c.verdict == Verdict::Regression;
+        (regression ? regressions : improvements) += 1;
+        std::cout << "\x1b[" << (regression ? 31 : 32) << 'm' << (regression ? "regression " : "improvement ") << "\x1b[0m"
+                  << c.kind << '/' << c.name << ": median " << std::defaultfloat << std::setprecision(4)
+                  << c.baseline_median << " -> " << c.current_median << " (" << std::showpos << std::fixed
+                  << std::setprecision(1) << c.change * 100 << "%" << std::noshowpos << ", p = "
+                  << std::setprecision(4) << c.p_value << ", delta = " << std::setprecision(2) << c.effect
+                  << ", n = " << c.current_count << " vs " << c.baseline_count << ')' << std::endl;
+    }
+    std::cout << "history: " << comparisons.size() << " series compared, " << regressions << " regression(s), "
+              << improvements << " improvement(s), " << insufficient << " with too few samples" << std::endl;
+    return regressions ? EXIT_REGRESSION : EXIT_SUCCESS;
+}
+
+static bool parse_ratio(const char *arg, double &ratio) {
+    return arg && std::sscanf(arg, "%lf", &ratio) == 1 && ratio >= 0 && ratio <= 1;
+}
+
+static bool parse_shard(const char *arg, unsigned int &index, unsigned int &count) {
+    return arg && std::sscanf(arg, "%u/%u", &index, &count) == 2 && index >= 1 && index <= count;
+}
+
+static bool parse_jobs(const char *arg, unsigned int &jobs) {
+    return arg && std::sscanf(arg, "%u", &jobs) == 1 && jobs > 0;
+}
+
+static bool parse_seconds(const char *arg, double &seconds) {
+    return arg && std::sscanf(arg, "%lf", &seconds) == 1 && seconds >= 0;
+}
+
+static bool parse_mib(const char *arg, unsigned long &mib) {
+    return arg && std::sscanf(arg, "%lu", &mib) == 1;
+}
+
+int main(int argc, char **argv) {
+    auto concurrency = std::thread::hardware_concurrency();
+    if (concurrency == 0) {
+        concurrency = 1;
+    }
+
+    auto simple = false, direct = false, cache = true, fork_server = false, counters = false;
+    auto build_jobs = concurrency, run_jobs = concurrency;
+    std::filesystem::path report, timings = log_dir() / "timings.csv";
+    std::vector<std::filesystem::path> merge;
+    auto history = log_dir() / "history.csv";
+    auto repeat = 1u;
+    auto compare = false, compare_only = false;
+    CompareOptions compare_options;
+    auto shard_index = 0u, shard_count = 0u;
+    auto build_limits = DEFAULT_BUILD_LIMITS, run_limits = DEFAULT_RUN_LIMITS;
+    for (auto i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--simple") == 0) {
+            simple = true;
+        } else if (std::strcmp(argv[i], "--direct") == 0) {
+            direct = true;
+        } else if (std::strcmp(argv[i], "--fork-server") == 0) {
+            direct = fork_server = true;
+        } else if (std::strcmp(argv[i], "--counters") == 0) {
+            counters = true;
+        } else if (std::strcmp(argv[i], "--no-cache") == 0) {
+            cache = false;
+        } else if (std::strcmp(argv[i], "--report") == 0 && i + 1 < argc) {
+            report = log_dir() / argv[++i];
+        } else if (std::strcmp(argv[i], "--timings") == 0 && i + 1 < argc) {
+            timings = log_dir() / argv[++i];
+        } else if (std::strcmp(argv[i], "--shard") == 0 && parse_shard(argv[i + 1], shard_index, shard_count)) {
+            ++i;
+        } else if (std::strcmp(argv[i], "--merge") == 0 && i + 1 < argc) {
+            // 之后直到下一个选项的参数都是要合并的报告
+            while (i + 1 < argc && std::strncmp(argv[i + 1], "--", 2) != 0) {
+                merge.push_back(log_dir() / argv[++i]);
+            }
+        } else if (std::strcmp(argv[i], "--history") == 0 && i + 1 < argc) {
+            history = log_dir() / argv[++i];
+        } else if (std::strcmp(argv[i], "--repeat") == 0 && parse_jobs(argv[i + 1], repeat)) {
+            ++i;
+        } else if (std::strcmp(argv[i], "--compare") == 0) {
+            compare = true;
+        } else if (std::strcmp(argv[i], "--compare-only") == 0) {
+            compare = compare_only = true;
+        } else if (std::strcmp(argv[i], "--baseline-runs") == 0 && parse_jobs(argv[i + 1], compare_options.baseline_runs)) {
+            ++i;
+        } else if (std::strcmp(argv[i], "--alpha") == 0 && parse_ratio(argv[i + 1], compare_options.alpha)) {
+            ++i;
+        } else if (std::strcmp(argv[i], "--threshold") == 0 && parse_ratio(argv[i + 1], compare_options.threshold)) {
+            ++i;
+        } else if (std::strcmp(argv[i], "--build-timeout") == 0 && parse_seconds(argv[i + 1], build_limits.timeout)) {
+            ++i;
+        } else if (std::strcmp(argv[i], "--run-timeout") == 0 && parse_seconds(argv[i + 1], run_limits.timeout)) {
+            ++i;
+        } else if (std::strcmp(argv[i], "--build-memory") == 0 && parse_mib(argv[i + 1], build_limits.memory)) {
+            ++i;
+        } else if (std::strcmp(argv[i], "--run-memory") == 0 && parse_mib(argv[i + 1], run_limits.memory)) {
+            ++i;
+        } else if (std::strcmp(argv[i], "-j") == 0 && parse_jobs(argv[i + 1], build_jobs)) {
+            ++i;
+        } else if (std::strcmp(argv[i], "--run-jobs") == 0 && parse_jobs(argv[i + 1], run_jobs)) {
+            ++i;
+        } else {
+            std::cerr << "Usage: xmake run summary [--simple] [--direct] [--fork-server] [--counters] [--no-cache] [-j <build jobs>] [--run-jobs <jobs>] [--report <file.json|file.csv>]" << std::endl
+                      << "                         [--build-timeout <seconds>] [--run-timeout <seconds>] [--build-memory <MiB>] [--run-memory <MiB>]" << std::endl
+                      << "                         [--timings <file.csv>] [--shard <i>/<n>]" << std::endl
+                      << "                         [--history <file.csv>] [--repeat <runs>] [--compare] [--baseline-runs <runs>] [--alpha <p>] [--threshold <ratio>]" << std::endl
+                      << "       xmake run summary [--report <file.json|file.csv>] [--timings <file.csv>] --merge <shard.csv>..." << std::endl
+                      << "       xmake run summary [--history <file.csv>] [--baseline-runs <runs>] [--alpha <p>] [--threshold <ratio>] --compare-only" << std::endl
+                      << "Timeouts and memory limits of 0 mean unlimited." << std::endl
+                      << "-j sets the parallelism of the batched build of --direct; --run-jobs sets the number of exercises built and run at once." << std::endl
+                      << "--fork-server implies --direct and runs exercises built with `xmake f --shared=y` in a preloading fork server." << std::endl
+                      << "--counters reads hardware performance counters of exercises run directly (Linux only)." << std::endl
+                      << "--shard runs the i-th of n partitions (1-based) balanced by the timings file (default: timings.csv) and writes" << std::endl
+                      << "shard-<i>-of-<n>.csv unless --report is given; --merge combines such reports. Paths are relative to the log directory." << std::endl
+                      << "Run times are appended to the history file (default: history.csv); --compare tests the series sampled by this run" << std::endl
+                      << "against their previous runs (Mann-Whitney U) and exits with " << EXIT_REGRESSION << " on a regression;" << std::endl
+                      << "--compare-only tests the latest run of every series. --compare implies --repeat " << COMPARE_REPEAT << " or more," << std::endl
+                      << "since fewer samples per run can hardly be significant at alpha = 0.01." << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    // 每个练习只有一个样本时检验不可能显著，比较时至少重复运行 `COMPARE_REPEAT` 次
+    if (compare && !compare_only && repeat < COMPARE_REPEAT) {
+        repeat = COMPARE_REPEAT;
+    }
+    if (!merge.empty()) {
+        return merge_reports(merge, report, timings);
+    }
+    if (compare_only) {
+        return compare_history(history, compare_options);
+    }
+
+    std::vector<unsigned int> exercises(MAX_EXERCISE + 1);
+    std::iota(exercises.begin(), exercises.end(), 0u);
+    if (shard_count) {
+        exercises = shard_exercises(shard_index - 1, shard_count, load_timings(timings));
+        std::cout << "shard " << shard_index << '/' << shard_count << ": " << exercises.size() << " exercise(s)" << std::endl;
+        if (report.empty()) {
+            report = log_dir() / ("shard-" + std::to_string(shard_index) + "-of-" + std::to_string(shard_count) + ".csv");
+        }
+    }
+    // 分片只构建自己的练习，`direct` 模式下缺少的构建产物由各练习单独构建
+    auto prepare = [&](Log &log) {
+        log.cache = cache;
+        log.counters = counters;
+        log.build_limits = build_limits;
+        log.run_limits = run_limits;
+        log.repeat = repeat;
+        if (direct && shard_count) {
+            log.direct = true;
+        } else if (direct) {
+            log.build_all(build_jobs);
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    if (!simple) {
+        Log log{Console{}};
+        prepare(log);
+        std::unique_ptr<ForkServers> servers;
+        if (fork_server) {
+            servers = start_fork_servers(log, 1);
+        }
+        for (auto i : exercises) {
+            log << i;
+        }
+        std::cout << log.passed() << '/' << exercises.size() << ' ';
+        print_results(log);
+        std::cout << std::endl;
+        print_counters(log);
+        save_report(report, log);
+        if (!shard_count) {
+            update_timings(timings, log);
+        }
+        compare_options.run = append_history(history, log);
+        print_elapsed(start);
+        return compare ? compare_history(history, compare_options) : EXIT_SUCCESS;
+    }
+
+    std::cout << "jobs: " << run_jobs << std::endl;
+    Log log{Null{}};
+    prepare(log);
+    std::unique_ptr<ForkServers> servers;
+    if (fork_server) {
+        servers = start_fork_servers(log, run_jobs);
+    }
+
+    // 终端上显示实时进度，工作线程无锁地发布结果，这里直接读取结果表
+    std::atomic_bool done{false};
+    std::thread progress;
+    if (is_terminal()) {
+        progress = std::thread([&] {
+            while (!done) {
+                std::cout << '\r' << log.finished() << '/' << exercises.size() << ' ';
+                print_results(log);
+                std::cout << std::flush;
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+            std::cout << '\r';
+        });
+    }
+    auto stats = run_pipeline(log, exercises, run_jobs);
+    done = true;
+    if (progress.joinable()) {
+        progress.join();
+    }
 
-        std::cout << std::accumulate(log.result.begin(), log.result.end(), 0, std::plus{}) << '/' << MAX_EXERCISE + 1 << std::endl;
-        return EXIT_SUCCESS;
+    std::cout << log.passed() << '/' << exercises.size() << ' ';
+    print_results(log);
+    std::cout << std::endl;
+    print_stage("build", stats.build, stats.wall);
+    print_stage("run", stats.run, stats.wall);
+    print_counters(log);
+    save_report(report, log);
+    if (!shard_count) {
+        update_timings(timings, log);
     }
-    std::cerr << "Usage: xmake run summary [--simple]" << std::endl;
-    return EXIT_FAILURE;
+    compare_options.run = append_history(history, log);
+    print_elapsed(start);
+    return compare ? compare_history(history, compare_options) : EXIT_SUCCESS;
 }
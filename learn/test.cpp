@@ -1,68 +1,366 @@
 ﻿#include "test.h"
+#include "cache.h"
+#include "forkserver.h"
+#include "subprocess.h"
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 
 #ifndef __XMAKE__
 #define __XMAKE__ "XMAKE is not defined"
 #endif
 
 namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
 constexpr static auto XMAKE = __XMAKE__;
 
-static int process_run(const char *cmd, const char *proj, const char *log) {
+static double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+fs::path const &exercises_dir() {
     static const auto exercises = fs::absolute(fs::path(XMAKE) / "exercises");
-    auto command = std::string("xmake ") + cmd + " -P \"" + exercises.string() + "\" " + proj;
-    if (log) {
-        command += " >> ";
-        command += log;
-        command += " 2>&1";
+    return exercises;
+}
+
+fs::path const &log_dir() {
+    static const auto log = fs::absolute(fs::path(XMAKE) / "log");
+    return log;
+}
+
+static fs::path const &cache_dir() {
+    static const auto cache = log_dir() / "cache";
+    return cache;
+}
+
+static int process_run(const char *cmd, const char *proj, SpawnOptions const &options) {
+    std::vector<std::string> argv{"xmake"};
+    if (*cmd) {
+        argv.emplace_back(cmd);
+    }
+    argv.emplace_back("-P");
+    argv.push_back(exercises_dir().string());
+    if (proj) {
+        argv.emplace_back(proj);
+    }
+    return process_spawn(argv, options);
+}
+
+// 练习 n 的源码，即 exercises 下以 n 的两位编号开头的目录中的 main.cpp
+static fs::path exercise_source(unsigned int n) {
+    std::error_code ec;
+    char prefix[] = "XX_";
+    std::sprintf(prefix, "%02u_", n % 100);
+    for (auto const &entry : fs::directory_iterator(exercises_dir(), ec)) {
+        if (entry.is_directory() && entry.path().filename().string().rfind(prefix, 0) == 0) {
+            return entry.path() / "main.cpp";
+        }
+    }
+    return {};
+}
+
+// build 目录下名为 `name` 的最新构建产物，不比 `sources` 新时返回空路径
+static fs::path newest_binary(std::string const &name, fs::file_time_type sources) {
+    std::error_code ec;
+    fs::path ans;
+    fs::file_time_type newest;
+    auto const exe_win = name + ".exe";
+    for (auto it = fs::recursive_directory_iterator(exercises_dir() / "build", ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        auto file = it->path().filename().string();
+        if (it->is_directory()) {
+            // 跳过 .objs、.deps 等中间产物目录
+            if (file.front() == '.') {
+                it.disable_recursion_pending();
+            }
+        } else if (file == name || file == exe_win) {
+            auto time = it->last_write_time();
+            if (time >= sources && (ans.empty() || time > newest)) {
+                ans = it->path();
+                newest = time;
+            }
+        }
+    }
+    return ans;
+}
+
+fs::path exercise_library(unsigned int n) {
+#if defined(_WIN32)
+    char name[] = "exerciseXX_shared.dll";
+    std::sprintf(name, "exercise%02u_shared.dll", n % 100);
+#elif defined(__APPLE__)
+    char name[] = "libexerciseXX_shared.dylib";
+    std::sprintf(name, "libexercise%02u_shared.dylib", n % 100);
+#else
+    char name[] = "libexerciseXX_shared.so";
+    std::sprintf(name, "libexercise%02u_shared.so", n % 100);
+#endif
+    std::error_code ec;
+    auto const &exercises = exercises_dir();
+    auto sources = fs::last_write_time(exercises / "exercise.h", ec);
+    sources = std::max(sources, fs::last_write_time(exercises / "xmake.lua", ec));
+    sources = std::max(sources, fs::last_write_time(exercises / "shared" / "entry.cpp", ec));
+    return newest_binary(name, std::max(sources, fs::last_write_time(exercise_source(n), ec)));
+}
+
+// 直接运行练习 n 的命令：优先使用单独构建的 exerciseNN，其次是合并编译的 exercises；
+// 构建产物比源码旧或不存在时返回空
+static std::vector<std::string> exercise_command(unsigned int n, const char *name) {
+    std::error_code ec;
+    auto const &exercises = exercises_dir();
+
+    auto sources = fs::last_write_time(exercises / "exercise.h", ec);
+    sources = std::max(sources, fs::last_write_time(exercises / "xmake.lua", ec));
+    auto exe = newest_binary(name, std::max(sources, fs::last_write_time(exercise_source(n), ec)));
+    if (!exe.empty()) {
+        return {exe.string()};
+    }
+
+    sources = std::max(sources, fs::last_write_time(exercises / "pch.h", ec));
+    for (auto const &entry : fs::directory_iterator(exercises / "unity", ec)) {
+        sources = std::max(sources, fs::last_write_time(entry.path(), ec));
+    }
+    for (auto i = 0u; i <= MAX_EXERCISE; ++i) {
+        sources = std::max(sources, fs::last_write_time(exercise_source(i), ec));
+    }
+    exe = newest_binary("exercises", sources);
+    if (!exe.empty()) {
+        return {exe.string(), std::to_string(n)};
+    }
+    return {};
+}
+
+static bool build_exercise(unsigned int n, Log const &config, Log::Job &job) {
+    char str[] = "exerciseXX";
+    std::sprintf(str, "exercise%02u", n);
+
+    if (config.cache) {
+        job.key = cache_key(exercises_dir(), exercise_source(n));
+        CacheEntry entry;
+        if (cache_load(cache_dir(), str, entry) && entry.key == job.key) {
+            job.hit = true;
+            job.pass = entry.pass;
+            job.output = std::move(entry.output);
+            return true;
+        }
+    }
+    // 批量构建没有产出时（例如更早的练习编译失败导致中止）单独构建
+    if (config.direct && ((config.fork_servers && config.fork_servers->has(n)) || !exercise_command(n, str).empty())) {
+        return true;
+    }
+    auto code = process_run("", str, {&job.output, &job.record.build, config.build_limits});
+    job.cacheable = code >= 0;
+    job.record.timeout = code == SPAWN_TIMEOUT;
+    return code == EXIT_SUCCESS;
+}
+
+// 运行一次练习 n：优先交给 fork 服务器，其次直接执行构建产物，最后经过 xmake
+static int run_once(unsigned int n, const char *name, Log const &config, SpawnOptions options) {
+    auto code = SPAWN_FAILED;
+    if (config.direct && config.fork_servers && config.fork_servers->has(n)) {
+        code = config.fork_servers->run(n, options);
+        // 服务器无法运行该练习时改用可执行文件
+        if (code == SPAWN_FAILED && options.output) {
+            options.output->clear();
+        }
     }
-    return std::system(command.c_str());
+    if (code == SPAWN_FAILED) {
+        auto command = config.direct ? exercise_command(n, name) : std::vector<std::string>{};
+        if (command.empty()) {
+            // 经过 xmake 运行时计数器会混入 xmake 自身的开销，不读取
+            options.counters = nullptr;
+            code = process_run("run", name, options);
+        } else {
+            code = process_spawn(command, options);
+        }
+    }
+    return code;
 }
 
-static bool test_exercise(int n, const char *log) {
-    std::ofstream file;
-    if (log) {
-        file.open(log, std::ios::out | std::ios::app);
+static bool run_exercise(unsigned int n, Log const &config, bool built, Log::Job &job) {
+    char str[] = "exerciseXX";
+    std::sprintf(str, "exercise%02u", n);
+
+    auto pass = false;
+    if (job.hit) {
+        pass = job.pass;
+    } else if (built) {
+        SpawnOptions options{&job.output, &job.record.run, config.run_limits};
+        if (config.direct && config.counters) {
+            options.counters = &job.record.counters;
+        }
+        auto code = run_once(n, str, config, options);
+        // 失败和超时的运行耗时不代表练习的正常耗时，不作为样本
+        if (code == EXIT_SUCCESS) {
+            job.record.samples.push_back(job.record.run.wall);
+        }
+        // 重复运行只采集耗时样本，输出和结果以第一次为准
+        for (auto i = 1u; i < config.repeat && code == EXIT_SUCCESS; ++i) {
+            std::string output;
+            Usage usage;
+            if (run_once(n, str, config, {&output, &usage, config.run_limits}) != EXIT_SUCCESS) {
+                break;
+            }
+            job.record.samples.push_back(usage.wall);
+        }
+        pass = code == EXIT_SUCCESS;
+        job.cacheable = job.cacheable && code >= 0;
+        job.record.timeout = code == SPAWN_TIMEOUT;
     }
-    std::ostream &os = log ? file : std::cout;
+    if (config.cache && !job.hit && job.cacheable) {
+        cache_store(cache_dir(), str, {job.key, pass, job.output});
+    }
+    return pass;
+}
 
+static std::string exercise_block(unsigned int n, bool pass, Log::Job const &job) {
     char str[] = "exerciseXX";
-    std::sprintf(str, "exercise%02d", n);
+    std::sprintf(str, "exercise%02u", n);
 
+    std::ostringstream os;
     os << "\x1b[34m" << str << " testing" << "\x1b[0m" << std::endl
-       << "==================" << std::endl;
-    auto pass = process_run("", str, log) == EXIT_SUCCESS && process_run("run", str, log) == EXIT_SUCCESS;
-    os << "=================" << std::endl
-       << "\x1b[" << (pass ? 32 : 31) << 'm' << str << (pass ? " passed" : " failed") << "\x1b[0m" << std::endl
+       << "==================" << std::endl
+       << job.output
+       << "=================" << std::endl
+       << "\x1b[" << (pass ? 32 : 31) << 'm' << str << (pass ? " passed" : job.record.timeout ? " timed out" : " failed")
+       << (job.hit ? " (cached)" : "") << "\x1b[0m" << std::endl
        << std::endl;
-    return pass;
+    return os.str();
 }
 
-Log &Log::operator<<(unsigned int n) {
-    namespace fs = std::filesystem;
-    bool pass;
-    if (std::holds_alternative<Console>(this->dst)) {
-        pass = test_exercise(n, nullptr);
-    } else if (std::holds_alternative<Null>(this->dst)) {
-#if defined(_WIN32)
-        constexpr auto null = "nul";
-#elif defined(__linux__) || defined(__unix__) || defined(__MACOSX__) || defined(__APPLE__)
-        constexpr auto null = "/dev/null";
-#else
-#error "Unsupported platform"
-#endif
-        pass = test_exercise(n, null);
-    } else {
-        const auto path = fs::absolute(fs::path(XMAKE) / "log" / std::get<fs::path>(this->dst));
-        const auto path_string = path.string();
-        pass = test_exercise(n, path_string.c_str());
+// 整块写出到日志目标，调用方持有 `Log::output_mutex`
+static void write_block(Log &log, std::string const &block) {
+    if (std::holds_alternative<Console>(log.dst)) {
+        std::cout << block << std::flush;
+    } else if (std::holds_alternative<fs::path>(log.dst)) {
+        if (!log.file.is_open()) {
+            auto path = log_dir() / std::get<fs::path>(log.dst);
+            std::error_code ec;
+            fs::create_directories(path.parent_path(), ec);
+            log.file.open(path, std::ios::out | std::ios::app | std::ios::binary);
+        }
+        log.file << block << std::flush;
     }
+}
+
+bool Log::build_all(unsigned int jobs) {
+    this->direct = true;
+    std::string output;
+    std::vector<std::string> argv{"xmake", "build"};
+    if (jobs) {
+        argv.emplace_back("-j");
+        argv.push_back(std::to_string(jobs));
+    }
+    argv.emplace_back("-P");
+    argv.push_back(exercises_dir().string());
+    auto code = process_spawn(argv, {&output, nullptr, this->build_limits});
+    std::lock_guard lock(this->output_mutex);
+    write_block(*this, output);
+    return code == EXIT_SUCCESS;
+}
+
+void Log::schedule(std::vector<unsigned int> exercises) {
+    std::lock_guard lock(this->output_mutex);
+    this->order = std::move(exercises);
+    this->written = 0;
+    this->blocks.clear();
+}
+
+bool Log::build(unsigned int n) {
+    auto &slot = this->slots.at(n);
+    slot.status.store(Status::Pending, std::memory_order_release);
+    auto &job = slot.job = Job{};
+    auto start = Clock::now();
+    auto built = build_exercise(n, *this, job);
+    job.record.build.wall = seconds_since(start);
+    return built;
+}
+
+Log &Log::run(unsigned int n, bool built) {
+    auto &slot = this->slots.at(n);
+    auto &job = slot.job;
+    auto start = Clock::now();
+    auto pass = run_exercise(n, *this, built, job);
+    job.record.run.wall = seconds_since(start);
+    job.record.exercise = n;
+    job.record.pass = pass;
+    job.record.cached = job.hit;
+
+    auto block = exercise_block(n, pass, job);
+    job.output = {};
+    std::atomic_store_explicit(&slot.record, std::make_shared<Record const>(job.record), std::memory_order_release);
+    slot.status.store(pass              ? (job.hit ? Status::Cached : Status::Pass)
+                      : job.record.timeout ? Status::Timeout
+                                           : Status::Fail,
+                      std::memory_order_release);
     {
-        std::lock_guard lock(this->mutex);
-        this->result.push_back(pass);
+        std::lock_guard lock(this->output_mutex);
+        if (this->order.empty()) {
+            write_block(*this, block);
+        } else {
+            this->blocks.emplace(n, std::move(block));
+            for (; this->written < this->order.size(); ++this->written) {
+                auto it = this->blocks.find(this->order[this->written]);
+                if (it == this->blocks.end()) {
+                    break;
+                }
+                write_block(*this, it->second);
+                this->blocks.erase(it);
+            }
+        }
     }
     return *this;
 }
+
+Log &Log::operator<<(unsigned int n) {
+    return run(n, build(n));
+}
+
+void Log::restore(Record const &record) {
+    auto &slot = this->slots.at(record.exercise);
+    slot.job = Job{};
+    slot.job.hit = record.cached;
+    slot.job.record = record;
+    std::atomic_store_explicit(&slot.record, std::make_shared<Record const>(record), std::memory_order_release);
+    slot.status.store(record.pass      ? (record.cached ? Status::Cached : Status::Pass)
+                      : record.timeout ? Status::Timeout
+                                       : Status::Fail,
+                      std::memory_order_release);
+}
+
+Status Log::status(unsigned int n) const {
+    return this->slots.at(n).status.load(std::memory_order_acquire);
+}
+
+unsigned int Log::passed() const {
+    auto ans = 0u;
+    for (auto i = 0u; i <= MAX_EXERCISE; ++i) {
+        auto status = this->status(i);
+        ans += status == Status::Pass || status == Status::Cached;
+    }
+    return ans;
+}
+
+unsigned int Log::finished() const {
+    auto ans = 0u;
+    for (auto i = 0u; i <= MAX_EXERCISE; ++i) {
+        ans += this->status(i) != Status::Pending;
+    }
+    return ans;
+}
+
+std::vector<Log::Record> Log::records() const {
+    std::vector<Record> ans;
+    for (auto i = 0u; i <= MAX_EXERCISE; ++i) {
+        if (this->status(i) == Status::Pending) {
+            continue;
+        }
+        if (auto record = std::atomic_load_explicit(&this->slots[i].record, std::memory_order_acquire)) {
+            ans.push_back(*record);
+        }
+    }
+    return ans;
+}
@@ -1,18 +1,117 @@
 ﻿#ifndef __TEST_H__
 #define __TEST_H__
 
+#include "subprocess.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <string>
 #include <variant>
 #include <vector>
 
+constexpr unsigned int MAX_EXERCISE = 33;
+
+// 构建和运行阶段默认的期限及资源限制
+constexpr Limits DEFAULT_BUILD_LIMITS{300, 0};
+constexpr Limits DEFAULT_RUN_LIMITS{10, 1024};
+
+enum class Status : unsigned char {
+    Pending,
+    Pass,
+    Fail,
+    Timeout,
+    // 命中缓存的通过结果
+    Cached,
+};
+
+struct ForkServers;
+
 struct Console {};
 struct Null {};
 struct Log {
     std::variant<Console, Null, std::filesystem::path> dst;
-    std::vector<bool> result;
-    std::mutex mutex;
+    // 为真时不再经过 xmake，直接执行 `build_all` 产出的可执行文件
+    bool direct = false;
+    // 非空时 `direct` 模式下有共享库的练习交给 fork 服务器运行
+    ForkServers *fork_servers = nullptr;
+    // 为真时在 `direct` 模式下为每个练习的运行读取硬件性能计数器，内核拒绝访问时没有读数
+    bool counters = false;
+    // 每个通过的练习运行的次数，多出的运行只采集耗时样本
+    unsigned int repeat = 1;
+    // 为真时按内容哈希缓存结果，输入未变的练习不再构建和运行
+    bool cache = false;
+    // 构建和运行阶段的期限及资源限制，超出时练习记为超时
+    Limits build_limits = DEFAULT_BUILD_LIMITS;
+    Limits run_limits = DEFAULT_RUN_LIMITS;
+
+    // 练习的构建和运行耗时及资源占用，墙钟时间按整个阶段计
+    struct Record {
+        unsigned int exercise = 0;
+        bool pass = false, cached = false, timeout = false;
+        Usage build, run;
+        // 运行阶段的硬件性能计数器
+        Counters counters;
+        // 每次成功运行的墙钟时间（秒），重复运行时有多个
+        std::vector<double> samples;
+    };
+
+    // 正在测试的练习：内容哈希、是否命中缓存、捕获的输出及耗时
+    struct Job {
+        std::uint64_t key = 0;
+        bool hit = false, pass = false, cacheable = true;
+        std::string output;
+        Record record;
+    };
+
+    // 按练习编号预先分配的结果表。每个槽位同一时刻只属于一个工作线程，`job` 只由它读写；
+    // 它完成后先以 release 语义发布 `job.record` 的不可变副本 `record`，再发布 `status`。
+    // 读者以 acquire 语义读到非 Pending 后读取 `record`；练习再次测试（如 watch 模式）时槽位被复用，
+    // 旧的副本在仍持有它的读者读完后才释放，读者不会读到写了一半的记录
+    struct Slot {
+        std::atomic<Status> status{Status::Pending};
+        Job job;
+        std::shared_ptr<Record const> record;
+    };
+    std::array<Slot, MAX_EXERCISE + 1> slots;
+
+    // 每个练习的输出经管道捕获后整块写出。设置了 `order` 时按其顺序写出，
+    // 先完成的块在内存中等待排在前面的块；否则完成即写出。
+    std::vector<unsigned int> order;
+    std::size_t written = 0;
+    std::map<unsigned int, std::string> blocks;
+    std::mutex output_mutex;
+    std::ofstream file;
+
+    // 并发测试前设置输出顺序
+    void schedule(std::vector<unsigned int> exercises);
+    // 一次性构建所有练习并切换到 `direct` 模式，`jobs` 非 0 时作为 xmake 的并行编译数；返回批量构建是否全部成功
+    bool build_all(unsigned int jobs = 0);
+    // 测试的两个阶段：构建练习 n；运行练习 n 并记录结果，`built` 为假时直接记为失败
+    bool build(unsigned int n);
+    Log &run(unsigned int n, bool built);
     Log &operator<<(unsigned int n);
+    // 载入在其他进程（如另一个分片）中得到的结果并发布状态，不产生输出
+    void restore(Record const &record);
+
+    Status status(unsigned int n) const;
+    // 通过（含命中缓存）和已完成的练习数
+    unsigned int passed() const;
+    unsigned int finished() const;
+    // 已完成练习的记录，按练习编号排列
+    std::vector<Record> records() const;
 };
 
+// 练习项目目录
+std::filesystem::path const &exercises_dir();
+// 练习 n 以共享库形式构建（`xmake f --shared=y`）的最新产物，比源码旧或不存在时返回空路径
+std::filesystem::path exercise_library(unsigned int n);
+// 项目根目录下的 log 目录，日志、缓存和报告的相对路径都相对于它
+std::filesystem::path const &log_dir();
+
 #endif// __TEST_H__
@@ -0,0 +1,94 @@
+﻿#include "watch.h"
+#include <cstdlib>
+#include <iostream>
+
+#if defined(__linux__)
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <poll.h>
+#include <set>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+int watch(Log &log, int debounce_ms) {
+    auto fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "inotify_init1 failed: " << std::strerror(errno) << std::endl;
+        return EXIT_FAILURE;
+    }
+    // 编辑器可能直接写入，也可能写入临时文件后改名覆盖
+    constexpr auto MASK = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+    std::map<int, unsigned int> exercises;
+    std::error_code ec;
+    for (auto const &entry : fs::directory_iterator(exercises_dir(), ec)) {
+        unsigned int n;
+        auto name = entry.path().filename().string();
+        if (entry.is_directory() && std::sscanf(name.c_str(), "%2u_", &n) == 1 && name.size() > 3 && name[2] == '_' && n <= MAX_EXERCISE) {
+            auto wd = inotify_add_watch(fd, entry.path().c_str(), MASK);
+            if (wd >= 0) {
+                exercises[wd] = n;
+            }
+        }
+    }
+    if (exercises.empty()) {
+        std::cerr << "No exercise to watch in " << exercises_dir().string() << std::endl;
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    std::cout << "watching " << exercises.size() << " exercises, press Ctrl+C to stop" << std::endl;
+
+    alignas(inotify_event) char buf[4096];
+    std::set<unsigned int> changed;
+    for (;;) {
+        // 有待处理的修改时，安静 `debounce_ms` 之后再开始构建
+        pollfd pfd{fd, POLLIN, 0};
+        auto ready = poll(&pfd, 1, changed.empty() ? -1 : debounce_ms);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (ready == 0) {
+            std::cout << "\x1b[2J\x1b[H" << std::flush;
+            for (auto n : changed) {
+                log << n;
+            }
+            changed.clear();
+            continue;
+        }
+        auto len = read(fd, buf, sizeof(buf));
+        if (len <= 0) {
+            if (len < 0 && errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        for (auto p = buf; p < buf + len;) {
+            auto event = reinterpret_cast<inotify_event const *>(p);
+            if (event->len && std::strcmp(event->name, "main.cpp") == 0) {
+                auto it = exercises.find(event->wd);
+                if (it != exercises.end()) {
+                    changed.insert(it->second);
+                }
+            }
+            p += sizeof(inotify_event) + event->len;
+        }
+    }
+    close(fd);
+    return EXIT_FAILURE;
+}
+
+#else
+
+int watch(Log &, int) {
+    std::cerr << "--watch is only supported on Linux" << std::endl;
+    return EXIT_FAILURE;
+}
+
+#endif
@@ -0,0 +1,11 @@
+﻿#ifndef __WATCH_H__
+#define __WATCH_H__
+
+#include "test.h"
+
+// 监视各练习的 main.cpp，保存后立即重新构建并运行被修改的练习，直到进程被中断。
+// 编辑器保存时的连续事件在 `debounce_ms` 毫秒内合并为一次。
+// 不支持的平台上直接返回 EXIT_FAILURE。
+int watch(Log &log, int debounce_ms = 100);
+
+#endif// __WATCH_H__
@@ -6,7 +6,10 @@ set_languages("cxx17")
 target("test")
     set_kind("static")
     add_defines(string.format("__XMAKE__=\"%s\"", os.scriptdir():gsub("\\", "/")))
-    add_files("learn/test.cpp")
+    add_files("learn/test.cpp", "learn/subprocess.cpp", "learn/pipeline.cpp", "learn/cache.cpp", "learn/report.cpp", "learn/watch.cpp", "learn/forkserver.cpp", "learn/perf.cpp", "learn/shard.cpp", "learn/history.cpp")
+    if is_plat("linux") then
+        add_syslinks("dl", {public = true})
+    end
 
 target("learn")
     set_kind("binary")
@@ -17,3 +20,10 @@ target("summary")
     set_kind("binary")
     add_deps("test")
     add_files("learn/summary.cpp")
+
+-- 运行器自身的测试：`xmake build spawn_test && xmake run spawn_test`。不默认构建
+target("spawn_test")
+    set_kind("binary")
+    set_default(false)
+    add_deps("test")
+    add_files("learn/spawn_test.cpp")